@@ -67,6 +67,10 @@ void restore_interrupts(U32 primask) {
     asm volatile("msr primask, %0" : : "r"(primask) : "memory");
 }
 
+U32 get_active_exception() {
+    return __arm_rsr("ipsr") & 0x1FF;
+}
+
 void delay_cycles(U32 cycles) {
     // Each loop iteration takes approximately 3 cycles: 1 cycle for SUBS and 2 cycles for BNE with
     // the branch being taken (this could be longer but in practice this is pipelined efficiently
@@ -38,6 +38,9 @@ U32 save_disable_interrupts();
 // Restore primask state, possibly enabling interrupts
 void restore_interrupts(U32 primask);
 
+// Exception number of the active exception (IPSR), or 0 in thread mode
+U32 get_active_exception();
+
 // Delay a given number of cycles. This is accurate to within 1 cycle of the given number
 void delay_cycles(U32 cycles);
 
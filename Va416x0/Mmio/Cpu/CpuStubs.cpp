@@ -52,6 +52,10 @@ U32 save_disable_interrupts() {
 
 void restore_interrupts(U32 primask) {}
 
+U32 get_active_exception() {
+    return 0;
+}
+
 void delay_cycles(U32 num_cycles_delay) {}
 
 }  // namespace Cpu
@@ -0,0 +1,64 @@
+// Copyright 2026 California Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// ======================================================================
+// \title  Dwt.cpp
+// \brief  cpp file for Armv7-m Data Watchpoint and Trace (DWT) cycle counter
+// ======================================================================
+
+#include "Dwt.hpp"
+#include "Va416x0/Mmio/Amba/Amba.hpp"
+#include "Va416x0/Mmio/Lock/Lock.hpp"
+
+namespace Va416x0Mmio {
+namespace Dwt {
+
+constexpr U32 REG_DEMCR = 0xE000EDFC;
+constexpr U32 REG_DWT_CTRL = 0xE0001000;
+
+constexpr U32 DEMCR_TRCENA = (1 << 24);
+constexpr U32 DWT_CTRL_CYCCNTENA = (1 << 0);
+
+void enable_cycle_counter() {
+    Amba::write_u32(REG_DEMCR, Amba::read_u32(REG_DEMCR) | DEMCR_TRCENA);
+    Amba::memory_barrier();
+    Amba::write_u32(REG_DWT_CTRL, Amba::read_u32(REG_DWT_CTRL) | DWT_CTRL_CYCCNTENA);
+    Amba::memory_barrier();
+}
+
+bool is_cycle_counter_enabled() {
+    return (Amba::read_u32(REG_DEMCR) & DEMCR_TRCENA) != 0 &&
+           (Amba::read_u32(REG_DWT_CTRL) & DWT_CTRL_CYCCNTENA) != 0;
+}
+
+// Software extension of CYCCNT, see now_cycles64()
+static U32 s_cyccntHigh = 0;
+static U32 s_cyccntLastLow = 0;
+
+U64 now_cycles64() {
+    // The extension is shared with ISRs, so it must be updated atomically.
+    Lock::CriticalSectionLock lock;
+
+    const U32 low = now_cycles();
+    if (low < s_cyccntLastLow) {
+        s_cyccntHigh++;
+    }
+    s_cyccntLastLow = low;
+    return (static_cast<U64>(s_cyccntHigh) << 32) | low;
+}
+
+}  // namespace Dwt
+}  // namespace Va416x0Mmio
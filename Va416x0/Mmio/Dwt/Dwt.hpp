@@ -0,0 +1,65 @@
+// Copyright 2026 California Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// ======================================================================
+// \title  Dwt.hpp
+// \brief  hpp file for Armv7-m Data Watchpoint and Trace (DWT) cycle counter
+// ======================================================================
+
+#ifndef Components_Va416x0_Dwt_HPP
+#define Components_Va416x0_Dwt_HPP
+
+#include "Fw/Types/BasicTypes.h"
+
+namespace Va416x0Mmio {
+namespace Dwt {
+
+constexpr U32 REG_DWT_CYCCNT = 0xE0001004;
+
+// Enable the DWT cycle counter (CYCCNT). This also sets DEMCR.TRCENA, which
+// is required for any DWT register to be accessible. Enabling an already
+// running counter is harmless and does not reset it.
+void enable_cycle_counter();
+
+// Whether CYCCNT is currently counting
+bool is_cycle_counter_enabled();
+
+// Read the free-running 32-bit core cycle counter. The counter increments
+// once per HCLK cycle and wraps silently, so differences between two reads
+// must be computed with unsigned subtraction.
+//
+// This is the common timebase for MainLoop, VectorTable, MaskingMutex and
+// the Profiler. It is inline so that each timestamp costs a single load.
+// Unit test builds have no DWT, so DwtStub.cpp provides a stand-in instead.
+#ifdef __arm__
+inline U32 now_cycles() {
+    return *reinterpret_cast<volatile U32*>(REG_DWT_CYCCNT);
+}
+#else
+U32 now_cycles();
+#endif
+
+// Read the cycle counter extended to 64 bits. The upper half is maintained in
+// software and advances whenever a read observes that CYCCNT has wrapped, so
+// this must be called at least once per wrap period (2^32 cycles). MainLoop
+// calls it at the start of every main loop body. It takes a critical
+// section, so avoid calling it from ISRs.
+U64 now_cycles64();
+
+}  // namespace Dwt
+}  // namespace Va416x0Mmio
+
+#endif
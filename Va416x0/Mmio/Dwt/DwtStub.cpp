@@ -0,0 +1,48 @@
+// Copyright 2026 California Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// ======================================================================
+// \title  DwtStub.cpp
+// \brief  cpp file for DWT cycle counter unit test stub implementation
+// ======================================================================
+
+#include "Dwt.hpp"
+
+namespace Va416x0Mmio {
+namespace Dwt {
+
+static bool s_enabled = false;
+// Advances by one on every read, so that intervals measured in unit tests are never empty
+static U64 s_cycles = 0;
+
+void enable_cycle_counter() {
+    s_enabled = true;
+}
+
+bool is_cycle_counter_enabled() {
+    return s_enabled;
+}
+
+U32 now_cycles() {
+    return static_cast<U32>(s_cycles++);
+}
+
+U64 now_cycles64() {
+    return s_cycles++;
+}
+
+}  // namespace Dwt
+}  // namespace Va416x0Mmio
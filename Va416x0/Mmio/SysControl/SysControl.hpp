@@ -26,11 +26,19 @@ U32 constexpr AIRCR_VECTKEY = 0x05FA0000;
 U32 constexpr AIRCR_SYSRESETREQ = (1 << 2);
 U32 constexpr AIRCR_VECTCLRACTIVE = (1 << 1);
 
+U32 constexpr ICSR_PENDSVSET = (1 << 28);
+U32 constexpr ICSR_PENDSVCLR = (1 << 27);
 U32 constexpr ICSR_RETTOBASE = (1 << 11);
 
+U32 constexpr SCR_SLEEPONEXIT = (1 << 1);
+
 U32 constexpr CCR_DIV_0_TRP = (1 << 4);
 U32 constexpr CCR_UNALIGN_TRP = (1 << 3);
 
+// Priority of PendSV (exception 14) is bits[23:16] of SHPR3
+U32 constexpr SHPR3_PRI_14_SHIFT = 16;
+U32 constexpr SHPR3_PRI_14_MASK = (0xFF << SHPR3_PRI_14_SHIFT);
+
 U32 constexpr SHCSR_USGFAULTENA = (1 << 18);
 U32 constexpr SHCSR_BUSFAULTENA = (1 << 17);
 U32 constexpr SHCSR_MEMFAULTENA = (1 << 16);
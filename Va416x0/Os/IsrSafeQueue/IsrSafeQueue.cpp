@@ -20,20 +20,35 @@
 // ======================================================================
 
 #include "IsrSafeQueue.hpp"
+#include <Fw/Logger/Logger.hpp>
 #include <Fw/Types/Assert.hpp>
 #include <Fw/Types/ByteArray.hpp>
 #include <Fw/Types/MemAllocator.hpp>
+#include <Fw/Types/StringUtils.hpp>
 #include <cstdio>
 #include <cstring>
-#include <fprime-baremetal/Os/MemoryIdScope/MemoryIdScope.hpp>
-#include <new>
 #include "Os/Delegate.hpp"
 #include "Os/Queue.hpp"
+#include "Va416x0/Mmio/Dwt/Dwt.hpp"
 #include "Va416x0/Mmio/Lock/Lock.hpp"
 
 namespace Va416x0Os {
 namespace IsrSafeQueue {
 
+volatile U32 IsrSafeQueue::s_totalMessages = 0;
+volatile U32 IsrSafeQueue::s_totalSent = 0;
+volatile U32 IsrSafeQueue::s_totalReceived = 0;
+IsrSafeQueue::ReceiveObserver IsrSafeQueue::s_receiveObserver = nullptr;
+void* IsrSafeQueue::s_receiveObserverContext = nullptr;
+IsrSafeQueue::ModePolicy IsrSafeQueue::s_modePolicy = nullptr;
+IsrSafeQueueHandle* IsrSafeQueue::s_firstQueue = nullptr;
+FwSizeType IsrSafeQueue::s_poolUsed = 0;
+
+//! Queue storage is handed out from here in creation order and never returned. A disabled pool still takes one byte,
+//! since zero-length arrays are not allowed.
+static constexpr FwSizeType STORAGE_POOL_BYTES = ISR_SAFE_QUEUE_POOL_SIZE > 0 ? ISR_SAFE_QUEUE_POOL_SIZE : 1;
+alignas(IsrSafeQueue::BLOCK_ALIGNMENT) static U8 s_storagePool[STORAGE_POOL_BYTES];
+
 FwSizeType IsrSafeQueueHandle ::find_index() {
     FwSizeType index = this->m_indices[this->m_startIndex % this->m_depth];
     this->m_startIndex = (this->m_startIndex + 1) % this->m_depth;
@@ -61,6 +76,88 @@ void IsrSafeQueueHandle ::load_data(FwSizeType index, U8* destination, FwSizeTyp
     (void)::memcpy(destination, this->m_data + offset, static_cast<size_t>(size));
 }
 
+void IsrSafeQueueHandle ::stamp(FwSizeType index) {
+    if (this->m_timestamps != nullptr) {
+        this->m_timestamps[index] = Va416x0Mmio::Dwt::now_cycles();
+    }
+}
+
+U32 IsrSafeQueueHandle ::get_latency(FwSizeType index) const {
+    return (this->m_timestamps != nullptr) ? Va416x0Mmio::Dwt::now_cycles() - this->m_timestamps[index] : 0;
+}
+
+void IsrSafeQueueHandle ::record_receive(U32 latency) {
+    this->m_receiveCount = this->m_receiveCount + 1;
+    this->m_latencyTotal = this->m_latencyTotal + latency;
+    this->m_latencyMax = FW_MAX(this->m_latencyMax, latency);
+}
+
+FwSizeType IsrSafeQueueHandle ::get_message_count() const {
+    if (this->m_mode == QueueMode::SPSC) {
+        return this->spsc_count(this->m_spscHead.load(std::memory_order_acquire),
+                                this->m_spscTail.load(std::memory_order_acquire));
+    }
+    return this->m_ringActive ? this->m_ringCount : this->m_heap.getSize();
+}
+
+FwSizeType IsrSafeQueueHandle ::get_slots_in_use() const {
+    return this->get_message_count() + ((this->m_reservedIndex != NO_SLOT) ? 1 : 0) +
+           ((this->m_peekedIndex != NO_SLOT) ? 1 : 0);
+}
+
+void IsrSafeQueueHandle ::try_return_to_ring() {
+    if (!this->m_ringActive && this->m_mode == QueueMode::AUTO && this->m_heap.isEmpty() &&
+        this->m_reservedIndex == NO_SLOT && this->m_peekedIndex == NO_SLOT) {
+        this->m_ringActive = true;
+        this->m_ringHead = 0;
+    }
+}
+
+FwSizeType IsrSafeQueueHandle ::spsc_count(FwSizeType head, FwSizeType tail) const {
+    return (tail >= head) ? tail - head : tail + 2 * this->m_depth - head;
+}
+
+void IsrSafeQueueHandle ::set_mode(QueueMode mode) {
+    this->m_mode = mode;
+    this->m_ringActive = true;
+    this->m_ringHead = 0;
+    this->m_ringCount = 0;
+    this->m_spscHead.store(0, std::memory_order_relaxed);
+    this->m_spscTail.store(0, std::memory_order_relaxed);
+    this->m_reservedIndex = NO_SLOT;
+    this->m_peekedIndex = NO_SLOT;
+    if (mode == QueueMode::PRIORITY) {
+        this->migrate_ring_to_heap();
+    }
+}
+
+void IsrSafeQueueHandle ::migrate_ring_to_heap() {
+    FW_ASSERT(this->m_ringActive);
+    // Equal priorities leave the MaxHeap in the order they were pushed, so pushing oldest first keeps FIFO order
+    FwSizeType index = this->m_ringHead;
+    for (FwSizeType i = 0; i < this->m_ringCount; i++) {
+        FW_ASSERT(this->m_heap.push(this->m_ringPriority, index));
+        index = (index + 1 == this->m_depth) ? 0 : index + 1;
+    }
+    // A reserved slot directly follows the ring and a peeked slot directly precedes it. The slots in between are free.
+    const bool reserved = this->m_reservedIndex != NO_SLOT;
+    if (reserved) {
+        FW_ASSERT(this->m_reservedIndex == index, static_cast<FwAssertArgType>(this->m_reservedIndex));
+        index = (index + 1 == this->m_depth) ? 0 : index + 1;
+    }
+    const FwSizeType freeSlots = this->m_depth - this->m_ringCount - (reserved ? 1 : 0) -
+                                 ((this->m_peekedIndex != NO_SLOT) ? 1 : 0);
+    for (FwSizeType i = 0; i < freeSlots; i++) {
+        this->m_indices[i] = index;
+        index = (index + 1 == this->m_depth) ? 0 : index + 1;
+    }
+    this->m_startIndex = 0;
+    this->m_stopIndex = (freeSlots == this->m_depth) ? 0 : freeSlots;
+    this->m_ringActive = false;
+    this->m_ringHead = 0;
+    this->m_ringCount = 0;
+}
+
 IsrSafeQueue::~IsrSafeQueue() {}
 
 Os::QueueInterface::Status IsrSafeQueue::create(FwEnumStoreType id,
@@ -68,44 +165,41 @@ Os::QueueInterface::Status IsrSafeQueue::create(FwEnumStoreType id,
                                                 FwSizeType depth,
                                                 FwSizeType messageSize) {
     // Ensure we are created exactly once
-    FW_ASSERT(this->m_handle.m_indices == nullptr);
-    FW_ASSERT(this->m_handle.m_sizes == nullptr);
-    FW_ASSERT(this->m_handle.m_data == nullptr);
-    Os::Baremetal::MemoryIdScope tmp = Os::Baremetal::MemoryIdScope(id);
-
-    // Allocate indices list
-    FwSizeType* indices = new (std::nothrow) FwSizeType[depth];
-    if (indices == nullptr) {
-        return QueueInterface::Status::ALLOCATION_FAILED;
-    }
-    // Allocate sizes list or clean-up
-    FwSizeType* sizes = new (std::nothrow) FwSizeType[depth];
-    if (sizes == nullptr) {
-        delete[] indices;
-        return QueueInterface::Status::ALLOCATION_FAILED;
-    }
-    // Allocate sizes list or clean-up
-    U8* data = new (std::nothrow) U8[depth * messageSize];
-    if (data == nullptr) {
-        delete[] indices;
-        delete[] sizes;
-        return QueueInterface::Status::ALLOCATION_FAILED;
-    }
-    // Allocate max heap or clean-up
-    Fw::MemAllocatorRegistry& registry = Fw::MemAllocatorRegistry::getInstance();
-    Fw::MemAllocator& allocator = registry.getAllocator(Fw::MemoryAllocation::MemoryAllocatorType::SYSTEM);
-
-    FwSizeType expSize = Types::MaxHeap::ELEMENT_SIZE * depth;
-    FwSizeType size = expSize;
-    void* memory = allocator.allocate(id, size, Types::MaxHeap::ALIGNMENT);
-
-    if (nullptr == memory || size != expSize) {
-        delete[] indices;
-        delete[] sizes;
-        delete[] data;
-        return QueueInterface::Status::ALLOCATION_FAILED;
-    }
-    this->m_handle.m_heap.create(depth, Fw::ByteArray(static_cast<U8*>(memory), size));
+    FW_ASSERT(this->m_handle.m_block == nullptr);
+
+    const StorageLayout layout = getStorageLayout(depth, messageSize);
+    U8* block = nullptr;
+    const bool fromPool = ISR_SAFE_QUEUE_POOL_SIZE > 0;
+    if (fromPool) {
+        block = allocateFromPool(layout.total);
+        if (block == nullptr) {
+            // The topology usually asserts on the failed create, so name the queue and the shortfall first
+            Fw::Logger::log("IsrSafeQueue %s needs %" PRI_FwSizeType " bytes, but only %" PRI_FwSizeType
+                            " of the %" PRI_FwSizeType " byte pool are left\n",
+                            name.toChar(), layout.total, ISR_SAFE_QUEUE_POOL_SIZE - getPoolUsed(),
+                            ISR_SAFE_QUEUE_POOL_SIZE);
+            return QueueInterface::Status::ALLOCATION_FAILED;
+        }
+    } else {
+        Fw::MemAllocatorRegistry& registry = Fw::MemAllocatorRegistry::getInstance();
+        Fw::MemAllocator& allocator = registry.getAllocator(Fw::MemoryAllocation::MemoryAllocatorType::SYSTEM);
+
+        FwSizeType size = layout.total;
+        void* memory = allocator.allocate(id, size, BLOCK_ALIGNMENT);
+        if (nullptr == memory || size != layout.total) {
+            if (nullptr != memory) {
+                allocator.deallocate(id, memory);
+            }
+            return QueueInterface::Status::ALLOCATION_FAILED;
+        }
+        block = static_cast<U8*>(memory);
+    }
+    this->m_handle.m_heap.create(depth, Fw::ByteArray(block, Types::MaxHeap::ELEMENT_SIZE * depth));
+
+    FwSizeType* indices = reinterpret_cast<FwSizeType*>(block + layout.indices);
+    FwSizeType* sizes = reinterpret_cast<FwSizeType*>(block + layout.sizes);
+    U32* timestamps = ISR_SAFE_QUEUE_LATENCY_TRACKING ? reinterpret_cast<U32*>(block + layout.timestamps) : nullptr;
+    U8* data = block + layout.data;
 
     // Assign initial indices and sizes
     for (FwSizeType i = 0; i < depth; i++) {
@@ -115,34 +209,68 @@ Os::QueueInterface::Status IsrSafeQueue::create(FwEnumStoreType id,
     // Set local tracking variables
     this->m_handle.m_id = id;
     this->m_handle.m_maxSize = messageSize;
-    this->m_handle.m_heapPointer = memory;
+    this->m_handle.m_block = block;
+    this->m_handle.m_blockFromPool = fromPool;
     this->m_handle.m_indices = indices;
     this->m_handle.m_data = data;
     this->m_handle.m_sizes = sizes;
+    this->m_handle.m_timestamps = timestamps;
     this->m_handle.m_startIndex = 0;
     this->m_handle.m_stopIndex = 0;
     this->m_handle.m_depth = depth;
     this->m_handle.m_highMark = 0;
+    this->m_handle.m_observerTag = -1;
+    this->m_handle.m_owner = this;
+    this->m_handle.m_dropCount = 0;
+    this->m_handle.m_receiveCount = 0;
+    this->m_handle.m_latencyMax = 0;
+    this->m_handle.m_latencyTotal = 0;
+    this->m_handle.set_mode((s_modePolicy != nullptr) ? s_modePolicy(id, name.toChar()) : QueueMode::AUTO);
+
+    // Append to the registry, so that positions in it don't change as queues are created
+    {
+        Va416x0Mmio::Lock::CriticalSectionLock lock;
+        IsrSafeQueueHandle** link = &s_firstQueue;
+        while (*link != nullptr) {
+            link = &(*link)->m_nextQueue;
+        }
+        this->m_handle.m_nextQueue = nullptr;
+        *link = &this->m_handle;
+    }
+    (void)Fw::StringUtils::string_copy(this->m_handle.m_name, name.toChar(), sizeof(this->m_handle.m_name));
 
     return QueueInterface::Status::OP_OK;
 }
 
 void IsrSafeQueue::teardown() {
-    if (this->m_handle.m_data != nullptr) {
-        const FwEnumStoreType identifier = this->m_handle.m_id;
-        Fw::MemAllocatorRegistry& registry = Fw::MemAllocatorRegistry::getInstance();
-        Fw::MemAllocator& allocator = registry.getAllocator(Fw::MemoryAllocation::MemoryAllocatorType::SYSTEM);
+    if (this->m_handle.m_block != nullptr) {
+        {
+            Va416x0Mmio::Lock::CriticalSectionLock lock;
+            s_totalMessages = s_totalMessages - static_cast<U32>(this->m_handle.get_message_count());
+
+            IsrSafeQueueHandle** link = &s_firstQueue;
+            while (*link != &this->m_handle) {
+                FW_ASSERT(*link != nullptr);
+                link = &(*link)->m_nextQueue;
+            }
+            *link = this->m_handle.m_nextQueue;
+        }
         this->m_handle.m_heap.teardown();
-        allocator.deallocate(identifier, this->m_handle.m_heapPointer);
 
-        delete[] this->m_handle.m_data;
-        delete[] this->m_handle.m_indices;
-        delete[] this->m_handle.m_sizes;
+        // Pool blocks are never reused, as queues are only torn down at shutdown
+        if (!this->m_handle.m_blockFromPool) {
+            Fw::MemAllocatorRegistry& registry = Fw::MemAllocatorRegistry::getInstance();
+            Fw::MemAllocator& allocator = registry.getAllocator(Fw::MemoryAllocation::MemoryAllocatorType::SYSTEM);
+            allocator.deallocate(this->m_handle.m_id, this->m_handle.m_block);
+        }
 
         // Set these pointers to nullptr
+        this->m_handle.m_block = nullptr;
         this->m_handle.m_data = nullptr;
         this->m_handle.m_indices = nullptr;
         this->m_handle.m_sizes = nullptr;
+        this->m_handle.m_timestamps = nullptr;
+        this->m_handle.m_nextQueue = nullptr;
     }
 }
 
@@ -154,20 +282,45 @@ Os::QueueInterface::Status IsrSafeQueue::send(const U8* buffer,
     if (size > this->m_handle.m_maxSize) {
         return Os::QueueInterface::Status::SIZE_MISMATCH;
     }
+    if (this->m_handle.m_mode == QueueMode::SPSC) {
+        return this->sendSpsc(buffer, size, priority, blockType);
+    }
     // Artificial block scope for scope lock ensuring an unlock in all cases and ensuring an unlock before notify
     {
         Va416x0Mmio::Lock::CriticalSectionLock lock;
-        if (this->m_handle.m_heap.isFull()) {
+        if (this->m_handle.get_slots_in_use() == this->m_handle.m_depth) {
+            this->m_handle.m_dropCount = this->m_handle.m_dropCount + 1;
             return blockType == BlockingType::BLOCKING ? Os::QueueInterface::Status::NOT_SUPPORTED
                                                        : Os::QueueInterface::Status::FULL;
         }
-        FwSizeType index = this->m_handle.find_index();
+        const FwSizeType count = this->m_handle.get_message_count();
+        // A reserved slot sits where the ring would put this message
+        if (this->m_handle.m_ringActive && ((count > 0 && priority != this->m_handle.m_ringPriority) ||
+                                            this->m_handle.m_reservedIndex != IsrSafeQueueHandle::NO_SLOT)) {
+            this->m_handle.migrate_ring_to_heap();
+        }
 
-        // Space must exist, push must work
-        FW_ASSERT(this->m_handle.m_heap.push(priority, index));
-        this->m_handle.store_data(index, buffer, size);
-        this->m_handle.m_sizes[index] = size;
-        this->m_handle.m_highMark = FW_MAX(this->m_handle.m_highMark, this->getMessagesAvailable());
+        if (this->m_handle.m_ringActive) {
+            FwSizeType index = this->m_handle.m_ringHead + count;
+            if (index >= this->m_handle.m_depth) {
+                index -= this->m_handle.m_depth;
+            }
+            this->m_handle.store_data(index, buffer, size);
+            this->m_handle.stamp(index);
+            this->m_handle.m_ringPriority = priority;
+            this->m_handle.m_ringCount = count + 1;
+        } else {
+            FwSizeType index = this->m_handle.find_index();
+
+            // Space must exist, push must work
+            FW_ASSERT(this->m_handle.m_heap.push(priority, index));
+            this->m_handle.store_data(index, buffer, size);
+            this->m_handle.m_sizes[index] = size;
+            this->m_handle.stamp(index);
+        }
+        this->m_handle.m_highMark = FW_MAX(this->m_handle.m_highMark, count + 1);
+        s_totalMessages = s_totalMessages + 1;
+        s_totalSent = s_totalSent + 1;
     }
     return QueueInterface::Status::OP_OK;
 }
@@ -177,26 +330,295 @@ Os::QueueInterface::Status IsrSafeQueue::receive(U8* destination,
                                                  QueueInterface::BlockingType blockType,
                                                  FwSizeType& actualSize,
                                                  FwQueuePriorityType& priority) {
+    FW_ASSERT(this->m_handle.m_peekedIndex == IsrSafeQueueHandle::NO_SLOT);
+    if (this->m_handle.m_mode == QueueMode::SPSC) {
+        return this->receiveSpsc(destination, capacity, blockType, actualSize, priority);
+    }
     {
         Va416x0Mmio::Lock::CriticalSectionLock lock;
-        if (this->m_handle.m_heap.isEmpty()) {
+        if (this->m_handle.get_message_count() == 0) {
             return blockType == BlockingType::BLOCKING ? Os::QueueInterface::Status::NOT_SUPPORTED
                                                        : Os::QueueInterface::Status::EMPTY;
         }
 
         FwSizeType index;
-        // Message must exist, so pop must pass and size must be valid
-        FW_ASSERT(this->m_handle.m_heap.pop(priority, index));
+        if (this->m_handle.m_ringActive) {
+            index = this->m_handle.m_ringHead;
+            priority = this->m_handle.m_ringPriority;
+            this->m_handle.m_ringHead = (index + 1 == this->m_handle.m_depth) ? 0 : index + 1;
+            this->m_handle.m_ringCount = this->m_handle.m_ringCount - 1;
+        } else {
+            // Message must exist, so pop must pass
+            FW_ASSERT(this->m_handle.m_heap.pop(priority, index));
+        }
         actualSize = this->m_handle.m_sizes[index];
         FW_ASSERT(actualSize <= capacity);
         this->m_handle.load_data(index, destination, actualSize);
-        this->m_handle.return_index(index);
+        this->m_handle.record_receive(this->m_handle.get_latency(index));
+        if (!this->m_handle.m_ringActive) {
+            this->m_handle.return_index(index);
+            // Once drained, the ring can be used again until a second priority shows up
+            this->m_handle.try_return_to_ring();
+        }
+        s_totalMessages = s_totalMessages - 1;
+        s_totalReceived = s_totalReceived + 1;
+    }
+    if (s_receiveObserver != nullptr) {
+        s_receiveObserver(s_receiveObserverContext, this->m_handle);
+    }
+    return QueueInterface::Status::OP_OK;
+}
+
+Os::QueueInterface::Status IsrSafeQueue::sendSpsc(const U8* buffer,
+                                                  FwSizeType size,
+                                                  FwQueuePriorityType priority,
+                                                  QueueInterface::BlockingType blockType) {
+    FW_ASSERT(this->m_handle.m_reservedIndex == IsrSafeQueueHandle::NO_SLOT);
+    const FwSizeType depth = this->m_handle.m_depth;
+    // Only this context writes the tail, and the receiver only ever frees slots
+    const FwSizeType tail = this->m_handle.m_spscTail.load(std::memory_order_relaxed);
+    const FwSizeType count = this->m_handle.spsc_count(this->m_handle.m_spscHead.load(std::memory_order_acquire), tail);
+    if (count == depth) {
+        Va416x0Mmio::Lock::CriticalSectionLock lock;
+        this->m_handle.m_dropCount = this->m_handle.m_dropCount + 1;
+        return blockType == BlockingType::BLOCKING ? Os::QueueInterface::Status::NOT_SUPPORTED
+                                                   : Os::QueueInterface::Status::FULL;
+    }
+    const FwSizeType index = (tail < depth) ? tail : tail - depth;
+    this->m_handle.store_data(index, buffer, size);
+    this->m_handle.m_indices[index] = static_cast<FwSizeType>(priority);
+    this->m_handle.stamp(index);
+    {
+        // Publish the message in the same critical section that counts it, so that a receiver in an ISR can't
+        // take it and decrement the total before it has been counted
+        Va416x0Mmio::Lock::CriticalSectionLock lock;
+        this->m_handle.m_spscTail.store((tail + 1 == 2 * depth) ? 0 : tail + 1, std::memory_order_release);
+        this->m_handle.m_highMark = FW_MAX(this->m_handle.m_highMark, count + 1);
+        s_totalMessages = s_totalMessages + 1;
+        s_totalSent = s_totalSent + 1;
     }
     return QueueInterface::Status::OP_OK;
 }
 
+Os::QueueInterface::Status IsrSafeQueue::receiveSpsc(U8* destination,
+                                                     FwSizeType capacity,
+                                                     QueueInterface::BlockingType blockType,
+                                                     FwSizeType& actualSize,
+                                                     FwQueuePriorityType& priority) {
+    const FwSizeType depth = this->m_handle.m_depth;
+    // Only this context writes the head, and the sender only ever fills slots
+    const FwSizeType head = this->m_handle.m_spscHead.load(std::memory_order_relaxed);
+    if (this->m_handle.spsc_count(head, this->m_handle.m_spscTail.load(std::memory_order_acquire)) == 0) {
+        return blockType == BlockingType::BLOCKING ? Os::QueueInterface::Status::NOT_SUPPORTED
+                                                   : Os::QueueInterface::Status::EMPTY;
+    }
+    const FwSizeType index = (head < depth) ? head : head - depth;
+    actualSize = this->m_handle.m_sizes[index];
+    FW_ASSERT(actualSize <= capacity);
+    this->m_handle.load_data(index, destination, actualSize);
+    priority = static_cast<FwQueuePriorityType>(this->m_handle.m_indices[index]);
+    // The sender may reuse the slot as soon as the head moves
+    const U32 latency = this->m_handle.get_latency(index);
+    this->m_handle.m_spscHead.store((head + 1 == 2 * depth) ? 0 : head + 1, std::memory_order_release);
+    {
+        Va416x0Mmio::Lock::CriticalSectionLock lock;
+        this->m_handle.record_receive(latency);
+        // The sender counts each message before publishing it
+        FW_ASSERT(s_totalMessages > 0);
+        s_totalMessages = s_totalMessages - 1;
+        s_totalReceived = s_totalReceived + 1;
+    }
+    if (s_receiveObserver != nullptr) {
+        s_receiveObserver(s_receiveObserverContext, this->m_handle);
+    }
+    return QueueInterface::Status::OP_OK;
+}
+
+Os::QueueInterface::Status IsrSafeQueue::reserve(U8*& slot, FwSizeType& capacity, BlockingType blockType) {
+    FW_ASSERT(blockType == BlockingType::NONBLOCKING);
+    const FwSizeType depth = this->m_handle.m_depth;
+    FwSizeType index;
+    // Check for an outstanding reservation in the same critical section that takes the slot, so that two contexts
+    // racing to reserve can't both get past the check
+    if (this->m_handle.m_mode == QueueMode::SPSC) {
+        Va416x0Mmio::Lock::CriticalSectionLock lock;
+        FW_ASSERT(this->m_handle.m_reservedIndex == IsrSafeQueueHandle::NO_SLOT);
+        const FwSizeType tail = this->m_handle.m_spscTail.load(std::memory_order_relaxed);
+        if (this->m_handle.spsc_count(this->m_handle.m_spscHead.load(std::memory_order_acquire), tail) == depth) {
+            this->m_handle.m_dropCount = this->m_handle.m_dropCount + 1;
+            return Os::QueueInterface::Status::FULL;
+        }
+        index = (tail < depth) ? tail : tail - depth;
+        this->m_handle.m_reservedIndex = index;
+    } else {
+        Va416x0Mmio::Lock::CriticalSectionLock lock;
+        FW_ASSERT(this->m_handle.m_reservedIndex == IsrSafeQueueHandle::NO_SLOT);
+        if (this->m_handle.get_slots_in_use() == depth) {
+            this->m_handle.m_dropCount = this->m_handle.m_dropCount + 1;
+            return Os::QueueInterface::Status::FULL;
+        }
+        if (this->m_handle.m_ringActive) {
+            index = this->m_handle.m_ringHead + this->m_handle.m_ringCount;
+            if (index >= depth) {
+                index -= depth;
+            }
+        } else {
+            index = this->m_handle.find_index();
+        }
+        this->m_handle.m_reservedIndex = index;
+    }
+    slot = this->m_handle.m_data + this->m_handle.m_maxSize * index;
+    capacity = this->m_handle.m_maxSize;
+    return QueueInterface::Status::OP_OK;
+}
+
+void IsrSafeQueue::commit(FwSizeType size, FwQueuePriorityType priority) {
+    const FwSizeType index = this->m_handle.m_reservedIndex;
+    FW_ASSERT(index != IsrSafeQueueHandle::NO_SLOT);
+    FW_ASSERT(size <= this->m_handle.m_maxSize, static_cast<FwAssertArgType>(size));
+    this->m_handle.m_sizes[index] = size;
+    this->m_handle.stamp(index);
+
+    if (this->m_handle.m_mode == QueueMode::SPSC) {
+        const FwSizeType depth = this->m_handle.m_depth;
+        const FwSizeType tail = this->m_handle.m_spscTail.load(std::memory_order_relaxed);
+        const FwSizeType count =
+            this->m_handle.spsc_count(this->m_handle.m_spscHead.load(std::memory_order_acquire), tail);
+        this->m_handle.m_indices[index] = static_cast<FwSizeType>(priority);
+        this->m_handle.m_reservedIndex = IsrSafeQueueHandle::NO_SLOT;
+
+        // As in sendSpsc, the message is published and counted together
+        Va416x0Mmio::Lock::CriticalSectionLock lock;
+        this->m_handle.m_spscTail.store((tail + 1 == 2 * depth) ? 0 : tail + 1, std::memory_order_release);
+        this->m_handle.m_highMark = FW_MAX(this->m_handle.m_highMark, count + 1);
+        s_totalMessages = s_totalMessages + 1;
+        s_totalSent = s_totalSent + 1;
+        return;
+    }
+
+    Va416x0Mmio::Lock::CriticalSectionLock lock;
+    const FwSizeType count = this->m_handle.get_message_count();
+    if (this->m_handle.m_ringActive && count > 0 && priority != this->m_handle.m_ringPriority) {
+        this->m_handle.migrate_ring_to_heap();
+    }
+    this->m_handle.m_reservedIndex = IsrSafeQueueHandle::NO_SLOT;
+    if (this->m_handle.m_ringActive) {
+        // The reserved slot directly follows the ring
+        this->m_handle.m_ringPriority = priority;
+        this->m_handle.m_ringCount = count + 1;
+    } else {
+        FW_ASSERT(this->m_handle.m_heap.push(priority, index));
+    }
+    this->m_handle.m_highMark = FW_MAX(this->m_handle.m_highMark, count + 1);
+    s_totalMessages = s_totalMessages + 1;
+    s_totalSent = s_totalSent + 1;
+}
+
+Os::QueueInterface::Status IsrSafeQueue::peek(U8*& message,
+                                              FwSizeType& size,
+                                              FwQueuePriorityType& priority,
+                                              BlockingType blockType) {
+    FW_ASSERT(blockType == BlockingType::NONBLOCKING);
+    FW_ASSERT(this->m_handle.m_peekedIndex == IsrSafeQueueHandle::NO_SLOT);
+    FwSizeType index;
+    if (this->m_handle.m_mode == QueueMode::SPSC) {
+        const FwSizeType depth = this->m_handle.m_depth;
+        const FwSizeType head = this->m_handle.m_spscHead.load(std::memory_order_relaxed);
+        if (this->m_handle.spsc_count(head, this->m_handle.m_spscTail.load(std::memory_order_acquire)) == 0) {
+            return Os::QueueInterface::Status::EMPTY;
+        }
+        index = (head < depth) ? head : head - depth;
+        priority = static_cast<FwQueuePriorityType>(this->m_handle.m_indices[index]);
+        // The head only moves on release, which keeps the sender from reusing the slot
+        Va416x0Mmio::Lock::CriticalSectionLock lock;
+        this->m_handle.record_receive(this->m_handle.get_latency(index));
+        // The sender counts each message before publishing it
+        FW_ASSERT(s_totalMessages > 0);
+        s_totalMessages = s_totalMessages - 1;
+        s_totalReceived = s_totalReceived + 1;
+    } else {
+        Va416x0Mmio::Lock::CriticalSectionLock lock;
+        if (this->m_handle.get_message_count() == 0) {
+            return Os::QueueInterface::Status::EMPTY;
+        }
+        if (this->m_handle.m_ringActive) {
+            index = this->m_handle.m_ringHead;
+            priority = this->m_handle.m_ringPriority;
+            this->m_handle.m_ringHead = (index + 1 == this->m_handle.m_depth) ? 0 : index + 1;
+            this->m_handle.m_ringCount = this->m_handle.m_ringCount - 1;
+        } else {
+            FW_ASSERT(this->m_handle.m_heap.pop(priority, index));
+        }
+        this->m_handle.record_receive(this->m_handle.get_latency(index));
+        s_totalMessages = s_totalMessages - 1;
+        s_totalReceived = s_totalReceived + 1;
+    }
+    this->m_handle.m_peekedIndex = index;
+    message = this->m_handle.m_data + this->m_handle.m_maxSize * index;
+    size = this->m_handle.m_sizes[index];
+
+    if (s_receiveObserver != nullptr) {
+        s_receiveObserver(s_receiveObserverContext, this->m_handle);
+    }
+    return QueueInterface::Status::OP_OK;
+}
+
+void IsrSafeQueue::release() {
+    const FwSizeType index = this->m_handle.m_peekedIndex;
+    FW_ASSERT(index != IsrSafeQueueHandle::NO_SLOT);
+    if (this->m_handle.m_mode == QueueMode::SPSC) {
+        const FwSizeType head = this->m_handle.m_spscHead.load(std::memory_order_relaxed);
+        this->m_handle.m_peekedIndex = IsrSafeQueueHandle::NO_SLOT;
+        this->m_handle.m_spscHead.store((head + 1 == 2 * this->m_handle.m_depth) ? 0 : head + 1,
+                                        std::memory_order_release);
+        return;
+    }
+
+    Va416x0Mmio::Lock::CriticalSectionLock lock;
+    this->m_handle.m_peekedIndex = IsrSafeQueueHandle::NO_SLOT;
+    // A slot peeked from the ring sits just before its head, where the ring only reaches once every other slot is full
+    if (!this->m_handle.m_ringActive) {
+        this->m_handle.return_index(index);
+        this->m_handle.try_return_to_ring();
+    }
+}
+
+IsrSafeQueueHandle* IsrSafeQueue::getNextQueue(const IsrSafeQueueHandle* queue) {
+    Va416x0Mmio::Lock::CriticalSectionLock lock;
+    return (queue == nullptr) ? s_firstQueue : queue->m_nextQueue;
+}
+
+void IsrSafeQueue::getQueueStats(IsrSafeQueueHandle& queue, QueueStats& stats) {
+    U32 received;
+    U64 latencyTotal;
+    {
+        Va416x0Mmio::Lock::CriticalSectionLock lock;
+        stats.depth = queue.m_depth;
+        stats.messages = queue.get_message_count();
+        stats.highMark = queue.m_highMark;
+        stats.drops = queue.m_dropCount;
+        stats.maxLatencyCycles = queue.m_latencyMax;
+        received = queue.m_receiveCount;
+        latencyTotal = queue.m_latencyTotal;
+        queue.m_receiveCount = 0;
+        queue.m_latencyMax = 0;
+        queue.m_latencyTotal = 0;
+    }
+    // Divide outside the critical section
+    stats.received = received;
+    stats.meanLatencyCycles = (received > 0) ? static_cast<U32>(latencyTotal / received) : 0;
+}
+
+IsrSafeQueue& IsrSafeQueue::fromQueue(Os::Queue& queue) {
+    IsrSafeQueueHandle* handle = static_cast<IsrSafeQueueHandle*>(queue.getHandle());
+    FW_ASSERT(handle != nullptr);
+    FW_ASSERT(handle->m_owner != nullptr);
+    return *handle->m_owner;
+}
+
 FwSizeType IsrSafeQueue::getMessagesAvailable() const {
-    return this->m_handle.m_heap.getSize();
+    Va416x0Mmio::Lock::CriticalSectionLock lock;
+    return this->m_handle.get_message_count();
 }
 
 FwSizeType IsrSafeQueue::getMessageHighWaterMark() const {
@@ -208,6 +630,56 @@ Os::QueueHandle* IsrSafeQueue::getHandle() {
     return &this->m_handle;
 }
 
+FwSizeType IsrSafeQueue::getTotalMessagesAvailable() {
+    return s_totalMessages;
+}
+
+U32 IsrSafeQueue::getTotalMessagesSent() {
+    return s_totalSent;
+}
+
+U32 IsrSafeQueue::getTotalMessagesReceived() {
+    return s_totalReceived;
+}
+
+void IsrSafeQueue::setMode(Os::Queue& queue, QueueMode mode) {
+    IsrSafeQueueHandle* handle = static_cast<IsrSafeQueueHandle*>(queue.getHandle());
+    FW_ASSERT(handle != nullptr);
+    FW_ASSERT(handle->m_block != nullptr);
+
+    Va416x0Mmio::Lock::CriticalSectionLock lock;
+    FW_ASSERT(handle->get_message_count() == 0, static_cast<FwAssertArgType>(handle->get_message_count()));
+    FW_ASSERT(handle->m_reservedIndex == IsrSafeQueueHandle::NO_SLOT);
+    FW_ASSERT(handle->m_peekedIndex == IsrSafeQueueHandle::NO_SLOT);
+    handle->set_mode(mode);
+}
+
+void IsrSafeQueue::setModePolicy(ModePolicy policy) {
+    Va416x0Mmio::Lock::CriticalSectionLock lock;
+    s_modePolicy = policy;
+}
+
+FwSizeType IsrSafeQueue::getPoolUsed() {
+    Va416x0Mmio::Lock::CriticalSectionLock lock;
+    return s_poolUsed;
+}
+
+U8* IsrSafeQueue::allocateFromPool(FwSizeType size) {
+    Va416x0Mmio::Lock::CriticalSectionLock lock;
+    if (size > ISR_SAFE_QUEUE_POOL_SIZE - s_poolUsed) {
+        return nullptr;
+    }
+    U8* block = &s_storagePool[s_poolUsed];
+    s_poolUsed += size;
+    return block;
+}
+
+void IsrSafeQueue::setReceiveObserver(ReceiveObserver observer, void* context) {
+    Va416x0Mmio::Lock::CriticalSectionLock lock;
+    s_receiveObserver = observer;
+    s_receiveObserverContext = context;
+}
+
 }  // namespace IsrSafeQueue
 }  // namespace Va416x0Os
 
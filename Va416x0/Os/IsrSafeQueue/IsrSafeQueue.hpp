@@ -18,10 +18,13 @@
 // \title Va416x0Os/IsrSafeQueue/IsrSafeQueue.hpp
 // \brief Alternative Os::Generic::PriorityQueue that does not rely on mutexes or condition variables
 // ======================================================================
+#include <atomic>
+
 #include "Os/Condition.hpp"
 #include "Os/Generic/Types/MaxHeap.hpp"
 #include "Os/Mutex.hpp"
 #include "Os/Queue.hpp"
+#include "config-vorago/IsrSafeQueueCfg.hpp"
 
 #ifndef Va416x0_Os_IsrSafeQueue_HPP
 #define Va416x0_Os_IsrSafeQueue_HPP
@@ -29,15 +32,40 @@
 namespace Va416x0Os {
 namespace IsrSafeQueue {
 
+//! \brief how an IsrSafeQueue orders its messages
+enum class QueueMode : U8 {
+    //! Messages are kept in a ring buffer while they all share one priority, making send and receive O(1). The first
+    //! message with a different priority moves the queued messages into the MaxHeap, and the ring is used again once
+    //! the queue drains.
+    AUTO,
+    //! Messages are always kept in the MaxHeap
+    PRIORITY,
+    //! Messages are kept in a lock-free ring and received in the order they were sent, whatever their priority. Only
+    //! one context may send and only one may receive, e.g. a single ISR producing for the main loop. Interrupts are
+    //! not masked while copying messages.
+    SPSC,
+};
+
+class IsrSafeQueue;
+
 //! \brief Critical data stored for ISR-safe queue
 //!
 //! The priority queue has two essential data structures: a block of unordered memory storing message data and size. The
 //! queue also stores a circular list of indices into that memory tracking which slots are free and which are taken.
 //! These indices are ordered by a max heap data structure projecting priority on to the otherwise unordered data. Both
 //! the data region and index list have queue depth number of entries.
+//!
+//! All regions are carved from a single block, in the order: max heap storage, indices, sizes, timestamps, data.
+//!
+//! While the ring is active, neither the max heap nor the index list is used. The messages instead occupy the data
+//! slots starting at m_ringHead, in the order they were sent. In QueueMode::SPSC, the index list instead holds the
+//! priority of the message in each slot.
+//!
+//! A slot handed out by IsrSafeQueue::reserve or IsrSafeQueue::peek belongs to neither the ring nor the free list until
+//! it is committed or released.
 struct IsrSafeQueueHandle : public Os::QueueHandle {
     Types::MaxHeap m_heap;            //!< MaxHeap data store for tracking priority
-    void* m_heapPointer = nullptr;    //!< Pointer to the MaxHeap data store
+    U8* m_block = nullptr;            //!< Storage block holding the MaxHeap data store, indices, sizes and data
     U8* m_data = nullptr;             //!< Pointer to data allocation
     FwSizeType* m_indices = nullptr;  //!< List of indices into data
     FwSizeType* m_sizes = nullptr;    //!< Size store for each method
@@ -47,6 +75,38 @@ struct IsrSafeQueueHandle : public Os::QueueHandle {
     FwSizeType m_maxSize = 0;         //!< Maximum size allowed of a message
     FwSizeType m_highMark = 0;        //!< Message count high water mark
     FwEnumStoreType m_id;             //!< Identifier for the queue, used for memory allocation
+    bool m_blockFromPool = false;     //!< True if m_block came from the static pool and must not be deallocated
+    FwIndexType m_observerTag = -1;   //!< Free for the receive observer to cache its own lookup, see below
+
+    // Ring buffer state, see QueueMode
+    QueueMode m_mode = QueueMode::AUTO;      //!< How messages are ordered
+    bool m_ringActive = true;                //!< True while messages are kept in the ring rather than the MaxHeap
+    FwSizeType m_ringHead = 0;               //!< Slot holding the oldest message in the ring
+    FwSizeType m_ringCount = 0;              //!< Number of messages in the ring
+    FwQueuePriorityType m_ringPriority = 0;  //!< Priority shared by every message in the ring
+
+    //! Positions of the next receive and the next send in QueueMode::SPSC, counting from 0 to 2 * depth - 1 so that a
+    //! full ring can be told apart from an empty one. Only the receiver writes m_spscHead and only the sender writes
+    //! m_spscTail.
+    std::atomic<FwSizeType> m_spscHead{0};
+    std::atomic<FwSizeType> m_spscTail{0};
+
+    //! Zero-copy state, see IsrSafeQueue::reserve and IsrSafeQueue::peek
+    static constexpr FwSizeType NO_SLOT = static_cast<FwSizeType>(-1);
+    IsrSafeQueue* m_owner = nullptr;       //!< Queue owning this handle, so that it can be found from an Os::Queue
+    FwSizeType m_reservedIndex = NO_SLOT;  //!< Slot handed out by reserve and not yet committed
+    FwSizeType m_peekedIndex = NO_SLOT;    //!< Slot handed out by peek and not yet released
+
+    //! Name of the queue, kept so that observers can report which component the queue belongs to
+    char m_name[FW_QUEUE_NAME_BUFFER_SIZE] = {};
+
+    // Instrumentation, see IsrSafeQueue::getQueueStats
+    U32* m_timestamps = nullptr;                //!< Cycle count at which each slot was queued, if latency is tracked
+    U32 m_dropCount = 0;                        //!< Sends and reservations refused because the queue was full
+    U32 m_receiveCount = 0;                     //!< Messages received since the statistics were last read
+    U32 m_latencyMax = 0;                       //!< Longest latency since the statistics were last read
+    U64 m_latencyTotal = 0;                     //!< Sum of latencies since the statistics were last read
+    IsrSafeQueueHandle* m_nextQueue = nullptr;  //!< Next queue in the registry, in creation order
 
     //!\brief find an available index to store data from the list
     FwSizeType find_index();
@@ -60,17 +120,78 @@ struct IsrSafeQueueHandle : public Os::QueueHandle {
 
     //!\brief load data from a set index in the data store
     void load_data(FwSizeType index, U8* destination, FwSizeType capacity);
+
+    //!\brief record the time at which the message in a slot was queued
+    void stamp(FwSizeType index);
+
+    //!\brief get the time the message in a slot has spent queued, or 0 if latency isn't tracked
+    U32 get_latency(FwSizeType index) const;
+
+    //!\brief update the receive statistics, from within a critical section
+    void record_receive(U32 latency);
+
+    //!\brief get the number of messages stored, whether in the ring or in the MaxHeap
+    FwSizeType get_message_count() const;
+
+    //!\brief get the number of slots holding messages or handed out by reserve or peek, outside QueueMode::SPSC
+    FwSizeType get_slots_in_use() const;
+
+    //!\brief switch from the MaxHeap back to the ring if the queue is in QueueMode::AUTO and nothing holds a slot
+    void try_return_to_ring();
+
+    //!\brief get the number of messages in the SPSC ring, given its head and tail positions
+    FwSizeType spsc_count(FwSizeType head, FwSizeType tail) const;
+
+    //!\brief switch an empty queue to a new mode
+    void set_mode(QueueMode mode);
+
+    //!\brief move the messages in the ring into the MaxHeap and rebuild the list of free indices
+    //!
+    //! This is O(depth log depth), but only happens when a queue first sees a second priority since it last drained.
+    //! Slots handed out by reserve and peek are left out of the free list.
+    void migrate_ring_to_heap();
 };
 //! \brief generic priority queue implementation
 //!
 //! \warning This Priority Queue is not ISR safe
 //!
 //! A generic implementation of a priority queue to support the Os::QueueInterface. This queue uses OSAL mutexes,
-//! and condition variables to provide for a task-safe blocking queue implementation. Data is stored in heap memory.
-//!
-//! \warning allocates memory on the heap
+//! and condition variables to provide for a task-safe blocking queue implementation. Data is stored in one block per
+//! queue, taken from a static pool of ISR_SAFE_QUEUE_POOL_SIZE bytes, or from the SYSTEM allocator if that is 0.
 class IsrSafeQueue : public Os::QueueInterface {
   public:
+    //! Alignment of the storage block and of each region within it
+    static constexpr FwSizeType BLOCK_ALIGNMENT = 8;
+    static_assert(Types::MaxHeap::ALIGNMENT <= BLOCK_ALIGNMENT, "MaxHeap storage must fit the block alignment");
+    static_assert(alignof(FwSizeType) <= BLOCK_ALIGNMENT, "index storage must fit the block alignment");
+
+    //! \brief offsets of each region within a queue's storage block
+    struct StorageLayout {
+        FwSizeType indices;     //!< Offset of the indices list
+        FwSizeType sizes;       //!< Offset of the sizes list
+        FwSizeType timestamps;  //!< Offset of the timestamps list, which is empty unless latency is tracked
+        FwSizeType data;        //!< Offset of the message data
+        FwSizeType total;       //!< Size of the whole block
+    };
+
+    //! \brief compute the storage block layout of a queue
+    static constexpr StorageLayout getStorageLayout(FwSizeType depth, FwSizeType messageSize) {
+        return StorageLayout{
+            heapBytes(depth),
+            heapBytes(depth) + indexBytes(depth),
+            heapBytes(depth) + 2 * indexBytes(depth),
+            heapBytes(depth) + 2 * indexBytes(depth) + timestampBytes(depth),
+            heapBytes(depth) + 2 * indexBytes(depth) + timestampBytes(depth) + alignUp(depth * messageSize),
+        };
+    }
+
+    //! \brief get the number of bytes a queue takes from the pool
+    //!
+    //! Summing this over every queue in the topology gives the value for ISR_SAFE_QUEUE_POOL_SIZE.
+    static constexpr FwSizeType getStorageSize(FwSizeType depth, FwSizeType messageSize) {
+        return getStorageLayout(depth, messageSize).total;
+    }
+
     //! \brief default queue interface constructor
     IsrSafeQueue() = default;
 
@@ -88,9 +209,8 @@ class IsrSafeQueue : public Os::QueueInterface {
 
     //! \brief create queue storage
     //!
-    //! Creates a queue ensuring sufficient storage to hold `depth` messages of `messageSize` size each.
-    //!
-    //! \warning allocates memory on the heap
+    //! Creates a queue ensuring sufficient storage to hold `depth` messages of `messageSize` size each. Returns
+    //! ALLOCATION_FAILED if the static pool is exhausted.
     //!
     //! \param id: identifier for the queue, used for memory allocation
     //! \param name: name of queue
@@ -146,6 +266,69 @@ class IsrSafeQueue : public Os::QueueInterface {
                    FwSizeType& actualSize,
                    FwQueuePriorityType& priority) override;
 
+    //! \brief reserve a slot to write a message into directly
+    //!
+    //! Hands out a pointer into the queue storage, so that a message can be serialized in place rather than copied in
+    //! by send. The message is only queued once commit is called. Only one slot may be reserved at a time. The slot is
+    //! aligned to IsrSafeQueue::BLOCK_ALIGNMENT only if the message size is. In QueueMode::SPSC, the sender must not
+    //! call send while holding a reservation.
+    //!
+    //! \param slot: (output) start of the reserved slot
+    //! \param capacity: (output) size of the reserved slot
+    //! \param blockType: must be NONBLOCKING
+    //! \return: status of the reservation, FULL if no slot is free
+    Status reserve(U8*& slot, FwSizeType& capacity, BlockingType blockType);
+
+    //! \brief queue the message written into the reserved slot
+    //!
+    //! \param size: size of the message written into the slot
+    //! \param priority: priority of the message
+    void commit(FwSizeType size, FwQueuePriorityType priority);
+
+    //! \brief get the next message without copying it out of the queue
+    //!
+    //! The message is removed from the queue, but its slot is only reused once release is called, so it can be
+    //! dispatched in place. receive and peek must not be called again until then.
+    //!
+    //! \param message: (output) start of the message
+    //! \param size: (output) size of the message
+    //! \param priority: (output) priority of the message
+    //! \param blockType: must be NONBLOCKING
+    //! \return: status of the peek, EMPTY if there is no message
+    Status peek(U8*& message, FwSizeType& size, FwQueuePriorityType& priority, BlockingType blockType);
+
+    //! \brief hand the slot returned by peek back to the queue
+    void release();
+
+    //! \brief statistics of one queue, see getQueueStats
+    struct QueueStats {
+        FwSizeType depth;       //!< Maximum number of messages
+        FwSizeType messages;    //!< Number of messages queued now
+        FwSizeType highMark;    //!< Message count high water mark
+        U32 drops;              //!< Sends and reservations refused because the queue was full
+        U32 received;           //!< Messages received since the previous call
+        U32 maxLatencyCycles;   //!< Longest time spent queued by the messages received since the previous call
+        U32 meanLatencyCycles;  //!< Mean time spent queued by the messages received since the previous call
+    };
+
+    //! \brief walk the registry of every created IsrSafeQueue
+    //!
+    //! Queues are registered in creation order, so positions in the registry only change if a queue is torn down.
+    //! \param queue: queue to start after, or nullptr to get the first queue
+    //! \return next queue, or nullptr at the end of the registry
+    static IsrSafeQueueHandle* getNextQueue(const IsrSafeQueueHandle* queue);
+
+    //! \brief read the statistics of a queue
+    //!
+    //! The receive count and latency statistics start over after every call, so only one component should sweep the
+    //! registry. Latency is in cycles of the DWT cycle counter, and is 0 unless ISR_SAFE_QUEUE_LATENCY_TRACKING is set.
+    static void getQueueStats(IsrSafeQueueHandle& queue, QueueStats& stats);
+
+    //! \brief get the IsrSafeQueue behind an Os::Queue, to use the zero-copy API
+    //!
+    //! The queue must have been created.
+    static IsrSafeQueue& fromQueue(Os::Queue& queue);
+
     //! \brief get number of messages available
     //!
     //! \return number of messages available
@@ -162,7 +345,94 @@ class IsrSafeQueue : public Os::QueueInterface {
 
     Os::QueueHandle* getHandle() override;
 
+    //! \brief get number of messages waiting across every IsrSafeQueue
+    //!
+    //! Allows a scheduler to tell whether any queue still has work pending without iterating the queues.
+    //! \return total messages currently stored in all queues
+    static FwSizeType getTotalMessagesAvailable();
+
+    //! \brief get number of messages sent across every IsrSafeQueue
+    //!
+    //! This counter wraps. Comparing two readings tells a scheduler whether any message arrived in between.
+    //! \return running count of successful sends
+    static U32 getTotalMessagesSent();
+
+    //! \brief get number of messages received across every IsrSafeQueue
+    //!
+    //! This counter wraps. Comparing two readings tells a scheduler whether any message was dispatched in between.
+    //! \return running count of successful receives
+    static U32 getTotalMessagesReceived();
+
+    //! \brief callback invoked after every successful receive
+    //!
+    //! Receives are how active components start dispatching a message, so an observer can tell which component is
+    //! running without any changes to the task runner. The observer may write `handle.m_observerTag`.
+    typedef void (*ReceiveObserver)(void* context, IsrSafeQueueHandle& handle);
+
+    //! \brief install the receive observer shared by every IsrSafeQueue
+    //!
+    //! Only one observer is supported. It is called outside the critical section, from whichever context received
+    //! the message. Pass nullptr to remove it.
+    static void setReceiveObserver(ReceiveObserver observer, void* context);
+
+    //! \brief choose how a queue orders its messages
+    //!
+    //! Queues start out in the mode chosen by the mode policy, or QueueMode::AUTO if there is none. The queue must
+    //! have been created and must be empty.
+    static void setMode(Os::Queue& queue, QueueMode mode);
+
+    //! \brief callback choosing the mode of each queue as it is created, from its identifier and name
+    typedef QueueMode (*ModePolicy)(FwEnumStoreType id, const char* name);
+
+    //! \brief install the mode policy shared by every IsrSafeQueue
+    //!
+    //! Must be installed before the topology creates its queues, since Os::Queue picks its delegate before the name
+    //! and identifier are known. Pass nullptr to remove it.
+    static void setModePolicy(ModePolicy policy);
+
+    //! \brief get the number of bytes of the static pool taken by queues so far
+    static FwSizeType getPoolUsed();
+
     IsrSafeQueueHandle m_handle;
+
+  private:
+    static constexpr FwSizeType alignUp(FwSizeType size) {
+        return (size + BLOCK_ALIGNMENT - 1) & ~(BLOCK_ALIGNMENT - 1);
+    }
+    static constexpr FwSizeType heapBytes(FwSizeType depth) { return alignUp(Types::MaxHeap::ELEMENT_SIZE * depth); }
+    static constexpr FwSizeType indexBytes(FwSizeType depth) { return alignUp(sizeof(FwSizeType) * depth); }
+    static constexpr FwSizeType timestampBytes(FwSizeType depth) {
+        return ISR_SAFE_QUEUE_LATENCY_TRACKING ? alignUp(sizeof(U32) * depth) : 0;
+    }
+
+    //! \brief take a block from the static pool, or return nullptr if it is exhausted
+    static U8* allocateFromPool(FwSizeType size);
+
+    //! \brief send without masking interrupts, for QueueMode::SPSC
+    Status sendSpsc(const U8* buffer, FwSizeType size, FwQueuePriorityType priority, BlockingType blockType);
+
+    //! \brief receive without masking interrupts, for QueueMode::SPSC
+    Status receiveSpsc(U8* destination,
+                       FwSizeType capacity,
+                       BlockingType blockType,
+                       FwSizeType& actualSize,
+                       FwQueuePriorityType& priority);
+
+    //! The totals are only modified inside the critical section taken by send/receive. They are U32 so that
+    //! unlocked reads are a single load. SPSC senders publish each message in the same critical section that counts
+    //! it, so a receiver can never uncount a message before it has been counted.
+    static volatile U32 s_totalMessages;
+    static volatile U32 s_totalSent;
+    static volatile U32 s_totalReceived;
+
+    static ReceiveObserver s_receiveObserver;
+    static void* s_receiveObserverContext;
+    static ModePolicy s_modePolicy;
+
+    //! Head of the queue registry, linked through IsrSafeQueueHandle::m_nextQueue
+    static IsrSafeQueueHandle* s_firstQueue;
+
+    static FwSizeType s_poolUsed;
 };
 
 }  // namespace IsrSafeQueue
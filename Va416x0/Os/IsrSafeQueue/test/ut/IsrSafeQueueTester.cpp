@@ -0,0 +1,259 @@
+// Copyright 2026 California Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// ======================================================================
+// \title  IsrSafeQueueTester.cpp
+// \brief  Tests of the IsrSafeQueue zero-copy API across ring and MaxHeap storage
+// ======================================================================
+
+#include <cstring>
+
+#include "Fw/Types/String.hpp"
+#include "Va416x0/Os/IsrSafeQueue/IsrSafeQueue.hpp"
+
+#include "gtest/gtest.h"
+
+using Va416x0Os::IsrSafeQueue::IsrSafeQueue;
+using Va416x0Os::IsrSafeQueue::QueueMode;
+using Status = Os::QueueInterface::Status;
+
+constexpr FwSizeType MESSAGE_SIZE = sizeof(U32);
+constexpr FwQueuePriorityType LOW = 1;
+constexpr FwQueuePriorityType HIGH = 2;
+
+class IsrSafeQueueTest : public testing::Test {
+  protected:
+    void create(FwSizeType depth, QueueMode mode) {
+        ASSERT_EQ(m_queue.create(0, Fw::String("TestQueue"), depth, MESSAGE_SIZE), Status::OP_OK);
+        if (mode != QueueMode::AUTO) {
+            m_queue.m_handle.set_mode(mode);
+        }
+    }
+
+    void TearDown() override { m_queue.teardown(); }
+
+    Status send(U32 value, FwQueuePriorityType priority) {
+        return m_queue.send(reinterpret_cast<const U8*>(&value), sizeof(value), priority,
+                            Os::QueueInterface::BlockingType::NONBLOCKING);
+    }
+
+    //! Reserve a slot and write value into it without committing it
+    U8* reserve(U32 value) {
+        U8* slot = nullptr;
+        FwSizeType capacity = 0;
+        EXPECT_EQ(m_queue.reserve(slot, capacity, Os::QueueInterface::BlockingType::NONBLOCKING), Status::OP_OK);
+        EXPECT_EQ(capacity, MESSAGE_SIZE);
+        if (slot != nullptr) {
+            ::memcpy(slot, &value, sizeof(value));
+        }
+        return slot;
+    }
+
+    //! Peek the next message, which must be value, and leave its slot held
+    const U8* peek(U32 value, FwQueuePriorityType priority) {
+        U8* message = nullptr;
+        FwSizeType size = 0;
+        FwQueuePriorityType actualPriority = 0;
+        EXPECT_EQ(m_queue.peek(message, size, actualPriority, Os::QueueInterface::BlockingType::NONBLOCKING),
+                  Status::OP_OK);
+        EXPECT_EQ(size, sizeof(value));
+        EXPECT_EQ(actualPriority, priority);
+        EXPECT_NE(message, nullptr);
+        if (message != nullptr) {
+            U32 actual = 0;
+            ::memcpy(&actual, message, sizeof(actual));
+            EXPECT_EQ(actual, value);
+        }
+        return message;
+    }
+
+    void expectReceive(U32 value, FwQueuePriorityType priority) {
+        U32 actual = 0;
+        FwSizeType size = 0;
+        FwQueuePriorityType actualPriority = 0;
+        ASSERT_EQ(m_queue.receive(reinterpret_cast<U8*>(&actual), sizeof(actual),
+                                  Os::QueueInterface::BlockingType::NONBLOCKING, size, actualPriority),
+                  Status::OP_OK);
+        EXPECT_EQ(size, sizeof(value));
+        EXPECT_EQ(actual, value);
+        EXPECT_EQ(actualPriority, priority);
+    }
+
+    void expectEmpty() {
+        U32 actual = 0;
+        FwSizeType size = 0;
+        FwQueuePriorityType priority = 0;
+        EXPECT_EQ(m_queue.receive(reinterpret_cast<U8*>(&actual), sizeof(actual),
+                                  Os::QueueInterface::BlockingType::NONBLOCKING, size, priority),
+                  Status::EMPTY);
+    }
+
+    IsrSafeQueue m_queue;
+};
+
+//! A reservation is queued in order when it is committed
+TEST_F(IsrSafeQueueTest, ReserveCommitInRing) {
+    this->create(4, QueueMode::AUTO);
+    ASSERT_EQ(this->send(1, LOW), Status::OP_OK);
+    this->reserve(2);
+    ASSERT_EQ(this->send(3, LOW), Status::OP_OK);
+    m_queue.commit(MESSAGE_SIZE, LOW);
+
+    // Sending past the reservation moves the queue into the MaxHeap, so the commit lands after the later send
+    this->expectReceive(1, LOW);
+    this->expectReceive(3, LOW);
+    this->expectReceive(2, LOW);
+    this->expectEmpty();
+    EXPECT_TRUE(m_queue.m_handle.m_ringActive);
+}
+
+//! A reserved slot survives migration to the MaxHeap and is not handed out to another sender
+TEST_F(IsrSafeQueueTest, ReserveHeldAcrossMigration) {
+    this->create(4, QueueMode::AUTO);
+    ASSERT_EQ(this->send(1, LOW), Status::OP_OK);
+    ASSERT_EQ(this->send(2, LOW), Status::OP_OK);
+    const U8* slot = this->reserve(3);
+
+    // A second priority moves the ring into the MaxHeap while the slot is reserved
+    ASSERT_EQ(this->send(4, HIGH), Status::OP_OK);
+    EXPECT_FALSE(m_queue.m_handle.m_ringActive);
+    ASSERT_EQ(this->send(5, LOW), Status::FULL);
+
+    U32 reserved = 0;
+    ::memcpy(&reserved, slot, sizeof(reserved));
+    EXPECT_EQ(reserved, 3U);
+    m_queue.commit(MESSAGE_SIZE, LOW);
+    ASSERT_EQ(this->send(5, LOW), Status::FULL);
+
+    this->expectReceive(4, HIGH);
+    this->expectReceive(1, LOW);
+    this->expectReceive(2, LOW);
+    this->expectReceive(3, LOW);
+    this->expectEmpty();
+
+    // Once drained, the queue returns to the ring and every slot is usable again
+    EXPECT_TRUE(m_queue.m_handle.m_ringActive);
+    for (U32 value = 10; value < 14; value++) {
+        ASSERT_EQ(this->send(value, LOW), Status::OP_OK);
+    }
+    for (U32 value = 10; value < 14; value++) {
+        this->expectReceive(value, LOW);
+    }
+}
+
+//! A peeked slot survives migration to the MaxHeap and is only reused after it is released
+TEST_F(IsrSafeQueueTest, PeekHeldAcrossMigration) {
+    this->create(4, QueueMode::AUTO);
+    ASSERT_EQ(this->send(1, LOW), Status::OP_OK);
+    ASSERT_EQ(this->send(2, LOW), Status::OP_OK);
+    const U8* message = this->peek(1, LOW);
+
+    // A second priority moves the ring into the MaxHeap while the slot is peeked
+    ASSERT_EQ(this->send(3, HIGH), Status::OP_OK);
+    EXPECT_FALSE(m_queue.m_handle.m_ringActive);
+    ASSERT_EQ(this->send(4, LOW), Status::OP_OK);
+    ASSERT_EQ(this->send(5, LOW), Status::FULL);
+
+    U32 peeked = 0;
+    ::memcpy(&peeked, message, sizeof(peeked));
+    EXPECT_EQ(peeked, 1U);
+    m_queue.release();
+
+    // The released slot goes back on the free list
+    ASSERT_EQ(this->send(5, LOW), Status::OP_OK);
+    this->expectReceive(3, HIGH);
+    this->expectReceive(2, LOW);
+    this->expectReceive(4, LOW);
+    this->expectReceive(5, LOW);
+    this->expectEmpty();
+    EXPECT_TRUE(m_queue.m_handle.m_ringActive);
+}
+
+//! The queue stays in the MaxHeap until every held slot has been handed back
+TEST_F(IsrSafeQueueTest, ReserveAndPeekHeldAcrossMigration) {
+    this->create(5, QueueMode::AUTO);
+    ASSERT_EQ(this->send(1, LOW), Status::OP_OK);
+    ASSERT_EQ(this->send(2, LOW), Status::OP_OK);
+    this->peek(1, LOW);
+    this->reserve(3);
+    ASSERT_EQ(this->send(4, HIGH), Status::OP_OK);
+    EXPECT_FALSE(m_queue.m_handle.m_ringActive);
+    ASSERT_EQ(this->send(5, LOW), Status::OP_OK);
+    ASSERT_EQ(this->send(6, LOW), Status::FULL);
+
+    // Messages can't be received while a slot is peeked, but the reservation can stay open
+    m_queue.release();
+    ASSERT_EQ(this->send(6, LOW), Status::OP_OK);
+    this->expectReceive(4, HIGH);
+    this->expectReceive(2, LOW);
+    this->expectReceive(5, LOW);
+    this->expectReceive(6, LOW);
+    this->expectEmpty();
+    EXPECT_FALSE(m_queue.m_handle.m_ringActive);
+
+    m_queue.commit(MESSAGE_SIZE, HIGH);
+    this->expectReceive(3, HIGH);
+    this->expectEmpty();
+    EXPECT_TRUE(m_queue.m_handle.m_ringActive);
+}
+
+//! Reservations and peeks in SPSC mode keep FIFO order
+TEST_F(IsrSafeQueueTest, SpscReserveAndPeek) {
+    this->create(3, QueueMode::SPSC);
+    ASSERT_EQ(this->send(1, LOW), Status::OP_OK);
+    this->reserve(2);
+    m_queue.commit(MESSAGE_SIZE, HIGH);
+    ASSERT_EQ(this->send(3, LOW), Status::OP_OK);
+    ASSERT_EQ(this->send(4, LOW), Status::FULL);
+
+    this->peek(1, LOW);
+    // The peeked slot stays taken until it is released
+    ASSERT_EQ(this->send(4, LOW), Status::FULL);
+    m_queue.release();
+    ASSERT_EQ(this->send(4, LOW), Status::OP_OK);
+
+    this->expectReceive(2, HIGH);
+    this->expectReceive(3, LOW);
+    this->expectReceive(4, LOW);
+    this->expectEmpty();
+}
+
+TEST_F(IsrSafeQueueTest, SpscTotals) {
+    this->create(3, QueueMode::SPSC);
+    const FwSizeType messages = IsrSafeQueue::getTotalMessagesAvailable();
+    const U32 sent = IsrSafeQueue::getTotalMessagesSent();
+    const U32 received = IsrSafeQueue::getTotalMessagesReceived();
+
+    ASSERT_EQ(this->send(1, LOW), Status::OP_OK);
+    this->reserve(2);
+    ASSERT_EQ(IsrSafeQueue::getTotalMessagesAvailable(), messages + 1);
+    m_queue.commit(MESSAGE_SIZE, LOW);
+    ASSERT_EQ(IsrSafeQueue::getTotalMessagesAvailable(), messages + 2);
+
+    // A peeked message is no longer counted, even before it is released
+    this->peek(1, LOW);
+    ASSERT_EQ(IsrSafeQueue::getTotalMessagesAvailable(), messages + 1);
+    m_queue.release();
+    this->expectReceive(2, LOW);
+    ASSERT_EQ(IsrSafeQueue::getTotalMessagesAvailable(), messages);
+    ASSERT_EQ(IsrSafeQueue::getTotalMessagesSent(), sent + 2);
+    ASSERT_EQ(IsrSafeQueue::getTotalMessagesReceived(), received + 2);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -21,7 +21,9 @@
 
 #include "Os/Delegate.hpp"
 #include "Os/Stub/ConditionVariable.hpp"
+#include "Va416x0/Mmio/ClkTree/ClkTree.hpp"
 #include "Va416x0/Mmio/Cpu/Cpu.hpp"
+#include "Va416x0/Mmio/Dwt/Dwt.hpp"
 
 #include "MaskingMutex.hpp"
 
@@ -30,9 +32,9 @@ namespace MaskingMutex {
 
 U32 MaskingMutex::s_nestingDepth = 0;
 U32 MaskingMutex::s_lastPrimask = 0;
-Os::RawTime MaskingMutex::s_lastTakeTime = {};
-U32 MaskingMutex::s_highWaterMarkUs = 0;
-U32 MaskingMutex::s_durationLimitUs = 0;
+U32 MaskingMutex::s_lastTakeCycles = 0;
+U32 MaskingMutex::s_highWaterMarkCycles = 0;
+U32 MaskingMutex::s_durationLimitCycles = 0;
 
 Os::Mutex::Status MaskingMutex::take() {
     // We enter the critical section immediately.
@@ -49,10 +51,7 @@ Os::Mutex::Status MaskingMutex::take() {
 
     if (s_nestingDepth == 0) {
         s_lastPrimask = primask;
-        Os::RawTime::Status status = s_lastTakeTime.now();
-        if (status != Os::RawTime::Status::OP_OK) {
-            return Os::Mutex::Status::ERROR_OTHER;
-        }
+        s_lastTakeCycles = Va416x0Mmio::Dwt::now_cycles();
     } else {
         // We only need to save the outermost primask, as long as nobody improperly
         // re-enabled interrupts inside the outer critical section. This will let us check.
@@ -81,22 +80,12 @@ Os::Mutex::Status MaskingMutex::release() {
     s_nestingDepth--;
 
     if (s_nestingDepth == 0) {
-        Os::RawTime endTime;
-        Os::RawTime::Status status = endTime.now();
-        // Make sure we restore interrupts on all paths.
+        const U32 difference = Va416x0Mmio::Dwt::now_cycles() - s_lastTakeCycles;
         Va416x0Mmio::Cpu::restore_interrupts(s_lastPrimask);
-        if (status != Os::RawTime::Status::OP_OK) {
-            return Os::Mutex::Status::ERROR_OTHER;
+        if (difference > s_highWaterMarkCycles) {
+            s_highWaterMarkCycles = difference;
         }
-        U32 difference = 0;
-        status = endTime.getDiffUsec(s_lastTakeTime, difference);
-        if (status != Os::RawTime::Status::OP_OK) {
-            return Os::Mutex::Status::ERROR_OTHER;
-        }
-        if (difference > s_highWaterMarkUs) {
-            s_highWaterMarkUs = difference;
-        }
-        if (s_durationLimitUs != 0 && difference > s_durationLimitUs) {
+        if (s_durationLimitCycles != 0 && difference > s_durationLimitCycles) {
             // Took too long!
             return Os::Mutex::Status::ERROR_DEADLOCK;
         }
@@ -106,10 +95,16 @@ Os::Mutex::Status MaskingMutex::release() {
 }
 
 void MaskingMutex::configureLimit(U32 durationLimitUs) {
-    FW_ASSERT(s_durationLimitUs == 0, durationLimitUs, s_highWaterMarkUs);
-    FW_ASSERT(durationLimitUs >= s_highWaterMarkUs, durationLimitUs, s_highWaterMarkUs);
+    // Critical sections are timed with the DWT cycle counter, so convert the limit to cycles once here.
+    const U32 cyclesPerUs = Va416x0Mmio::ClkTree::getActiveSysclkFreq() / 1000000;
+    FW_ASSERT(cyclesPerUs != 0);
+    FW_ASSERT(durationLimitUs <= 0xFFFFFFFF / cyclesPerUs, durationLimitUs, cyclesPerUs);
+    const U32 durationLimitCycles = durationLimitUs * cyclesPerUs;
+
+    FW_ASSERT(s_durationLimitCycles == 0, durationLimitCycles, s_highWaterMarkCycles);
+    FW_ASSERT(durationLimitCycles >= s_highWaterMarkCycles, durationLimitCycles, s_highWaterMarkCycles);
 
-    s_durationLimitUs = durationLimitUs;
+    s_durationLimitCycles = durationLimitCycles;
 }
 
 Os::MutexHandle* MaskingMutex::getHandle() {
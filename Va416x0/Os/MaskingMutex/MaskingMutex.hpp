@@ -20,7 +20,6 @@
 // ======================================================================
 
 #include "Os/Mutex.hpp"
-#include "Os/RawTime.hpp"
 
 #ifndef Va416x0_Os_MaskingMutex_HPP
 #define Va416x0_Os_MaskingMutex_HPP
@@ -40,6 +39,7 @@ struct MaskingMutexHandle : public Os::MutexHandle {
 //!
 //! In order to help ensure that the CPU is not reserved for too long, this mutex implementation will
 //! track the amount of time spent in each critical section and assert if it exceeds a defined limit.
+//! Critical sections are timed with the DWT cycle counter, which costs a single load on take and release.
 //!
 class MaskingMutex : public Os::MutexInterface {
   public:
@@ -70,9 +70,10 @@ class MaskingMutex : public Os::MutexInterface {
 
     static U32 s_nestingDepth;
     static U32 s_lastPrimask;
-    static Os::RawTime s_lastTakeTime;
-    static U32 s_highWaterMarkUs;
-    static U32 s_durationLimitUs;
+    //! Critical section timing, in DWT cycles
+    static U32 s_lastTakeCycles;
+    static U32 s_highWaterMarkCycles;
+    static U32 s_durationLimitCycles;
 };
 
 }  // namespace MaskingMutex
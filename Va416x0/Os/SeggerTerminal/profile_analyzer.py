@@ -0,0 +1,390 @@
+#!/usr/bin/python3
+# Copyright 2026 California Institute of Technology
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# SPDX-License-Identifier: Apache-2.0
+"""
+Offline analyzer for Va416x0Svc::Profiler captures
+
+Reads a dump of the profiler memory region from a file or over J-Link, resolves addresses against the ELF, and
+writes per-function statistics, a per-RTI breakdown, and a folded-stack file that can be rendered as a flame graph
+(for example with flamegraph.pl or speedscope).
+"""
+import argparse
+import bisect
+import csv
+import shutil
+import subprocess
+import sys
+from collections import defaultdict
+from dataclasses import dataclass, field
+from typing import Dict, List, Optional
+
+import Va416x0.Os.SeggerTerminal.config as config
+import Va416x0.Os.SeggerTerminal.profile_decode as profile_decode
+
+# Function whose entry marks the start of each RTI in event captures
+DEFAULT_RTI_FUNCTION = "Va416x0Svc::Metronome::main_timer_isr_handler"
+
+# Stack frame used for time that isn't inside any captured function
+UNTRACED = "<untraced>"
+UNKNOWN = "<unknown>"
+
+CYCLE_MASK = 0xFFFFFFFF
+
+
+class SymbolTable:
+    """Maps code addresses to function names, using nm so that no ELF parsing library is needed"""
+
+    def __init__(self, elf_path: Optional[str], nm: Optional[str] = None):
+        self._starts: List[int] = []
+        self._entries = []
+        if elf_path is None:
+            return
+
+        nm = nm or shutil.which("llvm-nm") or "nm"
+        output = subprocess.run(
+            [nm, "--defined-only", "--print-size", "--demangle", elf_path],
+            check=True,
+            capture_output=True,
+            text=True,
+        ).stdout
+
+        entries = []
+        for line in output.splitlines():
+            # "<address> <size> <type> <name>", where the size is missing for some symbols
+            parts = line.split(maxsplit=3)
+            if len(parts) == 4 and parts[2] in "TtWw":
+                address, size, name = int(parts[0], 16), int(parts[1], 16), parts[3]
+            elif len(parts) == 3 and parts[1] in "TtWw":
+                address, size, name = int(parts[0], 16), 0, parts[2]
+            else:
+                continue
+            entries.append((address & ~1, size, name))
+        entries.sort()
+        self._entries = entries
+        self._starts = [entry[0] for entry in entries]
+
+    def lookup(self, address: Optional[int]) -> str:
+        if address is None:
+            return UNKNOWN
+        index = bisect.bisect_right(self._starts, address) - 1
+        if index >= 0:
+            start, size, name = self._entries[index]
+            if address < start + max(size, 2):
+                return name
+        return f"0x{address:08X}"
+
+
+@dataclass
+class FunctionStats:
+    calls: int = 0
+    inclusive: int = 0
+    exclusive: int = 0
+
+
+@dataclass
+class Frame:
+    name: str
+    # Cycles spent in this frame itself
+    own: int = 0
+    # Inclusive cycles of the frames that it called
+    children: int = 0
+
+
+@dataclass
+class EventAnalysis:
+    functions: Dict[str, FunctionStats] = field(
+        default_factory=lambda: defaultdict(FunctionStats)
+    )
+    # Exclusive cycles, by RTI and then by function
+    rtis: Dict[int, Dict[str, int]] = field(
+        default_factory=lambda: defaultdict(lambda: defaultdict(int))
+    )
+    folded: Dict[str, int] = field(default_factory=lambda: defaultdict(int))
+    total_cycles: int = 0
+
+
+def function_base_name(name: str) -> str:
+    return name.split("(", 1)[0]
+
+
+def analyze_events(
+    events: List[profile_decode.ProfileEvent],
+    symbols: SymbolTable,
+    rti_function: str = DEFAULT_RTI_FUNCTION,
+) -> EventAnalysis:
+    analysis = EventAnalysis()
+
+    # Each exception has its own call stack. An exception that preempts another one pauses it, so
+    # the time of an ISR is not counted toward the functions that it interrupted.
+    stacks: Dict[int, List[Frame]] = defaultdict(list)
+    active_exceptions = [0]
+    rti = 0
+    previous_ticks = None
+
+    def pop_frame(stack: List[Frame]):
+        frame = stack.pop()
+        inclusive = frame.own + frame.children
+        # Only count the outermost call of a recursive function, so that time isn't counted twice
+        if all(other.name != frame.name for other in stack):
+            analysis.functions[frame.name].inclusive += inclusive
+        if stack:
+            stack[-1].children += inclusive
+
+    for event in events:
+        # Cycle counts wrap around, but deltas between neighboring events are always small
+        if previous_ticks is not None:
+            delta = (event.ticks - previous_ticks) & CYCLE_MASK
+            exception = active_exceptions[-1]
+            stack = stacks[exception]
+            names = [frame.name for frame in stack] or [UNTRACED]
+            if exception != 0:
+                names.insert(0, f"exception {exception}")
+            analysis.folded[";".join(names)] += delta
+            analysis.total_cycles += delta
+            if stack:
+                stack[-1].own += delta
+                analysis.functions[stack[-1].name].exclusive += delta
+                analysis.rtis[rti][stack[-1].name] += delta
+        previous_ticks = event.ticks
+
+        # Events from another exception mean that it either preempted the active one, or that
+        # the active one returned to it
+        if event.exception not in active_exceptions:
+            active_exceptions.append(event.exception)
+        else:
+            while active_exceptions[-1] != event.exception:
+                active_exceptions.pop()
+
+        stack = stacks[event.exception]
+        if not event.is_exit:
+            name = symbols.lookup(event.address)
+            if function_base_name(name) == rti_function:
+                rti += 1
+            analysis.functions[name].calls += 1
+            stack.append(Frame(name))
+            continue
+
+        # Exits from functions that were entered before the capture started have no frame
+        if event.address is None:
+            if stack:
+                pop_frame(stack)
+        else:
+            name = symbols.lookup(event.address)
+            depth = next(
+                (
+                    index
+                    for index in range(len(stack) - 1, -1, -1)
+                    if stack[index].name == name
+                ),
+                None,
+            )
+            if depth is not None:
+                while len(stack) > depth:
+                    pop_frame(stack)
+        if event.exception != 0 and not stack and len(active_exceptions) > 1:
+            active_exceptions.pop()
+
+    # Close the frames that were still open when the capture stopped
+    for stack in stacks.values():
+        while stack:
+            pop_frame(stack)
+    return analysis
+
+
+@dataclass
+class SampleAnalysis:
+    functions: Dict[str, int] = field(default_factory=lambda: defaultdict(int))
+    rtis: Dict[int, Dict[str, int]] = field(
+        default_factory=lambda: defaultdict(lambda: defaultdict(int))
+    )
+    folded: Dict[str, int] = field(default_factory=lambda: defaultdict(int))
+    total_samples: int = 0
+
+
+def analyze_samples(
+    samples: List[profile_decode.ProfileSample], symbols: SymbolTable
+) -> SampleAnalysis:
+    analysis = SampleAnalysis()
+    for sample in samples:
+        function = symbols.lookup(sample.pc)
+        analysis.functions[function] += 1
+        analysis.rtis[sample.rti][function] += 1
+        # The stacked LR is only the caller if the function hasn't called anything else yet, so the
+        # folded stacks are only two levels deep and approximate
+        if sample.pc is None:
+            analysis.folded[UNKNOWN] += 1
+        else:
+            analysis.folded[f"{symbols.lookup(sample.lr)};{function}"] += 1
+        analysis.total_samples += 1
+    return analysis
+
+
+def read_dump_jlink(address: int, size: int, speed=None) -> bytes:
+    # Only needed for live targets, so that offline analysis doesn't need the J-Link DLL
+    import pylink
+
+    if speed is None:
+        speed = config.get_speed()
+    jlink = pylink.JLink()
+    jlink.open()
+    try:
+        jlink.set_tif(pylink.enums.JLinkInterfaces.SWD)
+        speed = int(speed, 0) if isinstance(speed, str) else speed
+        jlink.connect("VA416xx", speed=speed)
+        return bytes(jlink.memory_read8(address, size))
+    finally:
+        jlink.close()
+
+
+def write_folded(path: str, folded: Dict[str, int]):
+    with open(path, "w") as output:
+        for stack, weight in sorted(folded.items()):
+            if weight:
+                output.write(f"{stack} {weight}\n")
+
+
+def write_event_reports(prefix: str, analysis: EventAnalysis, top: int):
+    functions = sorted(
+        analysis.functions.items(), key=lambda item: item[1].exclusive, reverse=True
+    )
+    with open(f"{prefix}.functions.csv", "w", newline="") as output:
+        writer = csv.writer(output)
+        writer.writerow(
+            [
+                "function",
+                "calls",
+                "inclusive_cycles",
+                "exclusive_cycles",
+                "exclusive_percent",
+            ]
+        )
+        for name, stats in functions:
+            percent = (
+                100 * stats.exclusive / analysis.total_cycles
+                if analysis.total_cycles
+                else 0
+            )
+            writer.writerow(
+                [name, stats.calls, stats.inclusive, stats.exclusive, f"{percent:.2f}"]
+            )
+    with open(f"{prefix}.rti.csv", "w", newline="") as output:
+        writer = csv.writer(output)
+        writer.writerow(["rti", "function", "exclusive_cycles"])
+        for rti in sorted(analysis.rtis):
+            for name, cycles in sorted(
+                analysis.rtis[rti].items(), key=lambda item: item[1], reverse=True
+            ):
+                writer.writerow([rti, name, cycles])
+    write_folded(f"{prefix}.folded", analysis.folded)
+
+    print(f"{analysis.total_cycles} cycles captured in {len(analysis.rtis)} RTIs")
+    print(f"{'exclusive':>12} {'inclusive':>12} {'calls':>8}  function")
+    for name, stats in functions[:top]:
+        print(f"{stats.exclusive:>12} {stats.inclusive:>12} {stats.calls:>8}  {name}")
+
+
+def write_sample_reports(prefix: str, analysis: SampleAnalysis, top: int):
+    functions = sorted(
+        analysis.functions.items(), key=lambda item: item[1], reverse=True
+    )
+    with open(f"{prefix}.functions.csv", "w", newline="") as output:
+        writer = csv.writer(output)
+        writer.writerow(["function", "samples", "percent"])
+        for name, count in functions:
+            writer.writerow(
+                [name, count, f"{100 * count / analysis.total_samples:.2f}"]
+            )
+    with open(f"{prefix}.rti.csv", "w", newline="") as output:
+        writer = csv.writer(output)
+        writer.writerow(["rti", "function", "samples"])
+        for rti in sorted(analysis.rtis):
+            for name, count in sorted(
+                analysis.rtis[rti].items(), key=lambda item: item[1], reverse=True
+            ):
+                writer.writerow([rti, name, count])
+    write_folded(f"{prefix}.folded", analysis.folded)
+
+    print(f"{analysis.total_samples} samples captured in {len(analysis.rtis)} RTIs")
+    print(f"{'samples':>8} {'percent':>8}  function")
+    for name, count in functions[:top]:
+        print(f"{count:>8} {100 * count / analysis.total_samples:>7.2f}%  {name}")
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Analyze a capture from the Profiler component",
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter,
+    )
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument(
+        "--dump", help="Binary dump of the whole profiler memory region"
+    )
+    source.add_argument(
+        "--jlink",
+        nargs=2,
+        metavar=("ADDRESS", "SIZE"),
+        help="Read the profiler memory region from the target over J-Link",
+    )
+    parser.add_argument(
+        "--save-dump",
+        help="When reading over J-Link, also save the region to this file",
+    )
+    parser.add_argument("--elf", help="ELF image used to resolve function addresses")
+    parser.add_argument("--nm", help="nm executable used to read the ELF symbols")
+    parser.add_argument(
+        "--rti-function",
+        default=DEFAULT_RTI_FUNCTION,
+        help="Function whose entry marks the start of an RTI in event captures",
+    )
+    parser.add_argument(
+        "-o", "--output-prefix", default="profile", help="Prefix of the report files"
+    )
+    parser.add_argument(
+        "--top", type=int, default=20, help="Number of functions to print"
+    )
+    args = parser.parse_args()
+
+    if args.jlink:
+        data = read_dump_jlink(int(args.jlink[0], 0), int(args.jlink[1], 0))
+        if args.save_dump:
+            with open(args.save_dump, "wb") as output:
+                output.write(data)
+    else:
+        with open(args.dump, "rb") as dump:
+            data = dump.read()
+
+    try:
+        decoded = profile_decode.decode(data)
+    except profile_decode.ProfileFormatError as e:
+        sys.exit(f"ERROR: {e}")
+    if not decoded:
+        sys.exit("ERROR: the capture is empty")
+
+    symbols = SymbolTable(args.elf, args.nm)
+    if isinstance(decoded[0], profile_decode.ProfileSample):
+        write_sample_reports(
+            args.output_prefix, analyze_samples(decoded, symbols), args.top
+        )
+    else:
+        write_event_reports(
+            args.output_prefix,
+            analyze_events(decoded, symbols, args.rti_function),
+            args.top,
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,275 @@
+#!/usr/bin/python3
+# Copyright 2026 California Institute of Technology
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# SPDX-License-Identifier: Apache-2.0
+"""
+Decoder for the memory region written by Va416x0Svc::Profiler
+
+The region starts with a header (see Profiler::Header) followed by either fixed-size events (FORMAT_EVENT), a
+stream of compact U16 records (FORMAT_COMPACT), or samples from the sampling timer (FORMAT_SAMPLE). Events in either
+format are decoded into the same list of ProfileEvent values, and samples into a list of ProfileSample values.
+"""
+import argparse
+import struct
+import sys
+from dataclasses import dataclass
+from typing import List, Optional, Union
+
+HEADER_MAGIC = 0x464F5250
+HEADER_STRUCT = struct.Struct("<IIII")
+
+# Events with the active exception number and 24 bits of the cycle counter
+FORMAT_EVENT = 1
+FORMAT_COMPACT = 2
+FORMAT_SAMPLE = 3
+
+FLAG_RING = 1 << 0
+FLAG_WRAPPED = 1 << 1
+FLAG_RECORDING = 1 << 2
+
+EVENT_STRUCT = struct.Struct("<II")
+PHASE_FUNC_EXIT = 1 << 31
+THUMB_MASK = 0x7FFFFFFE
+EXCEPTION_SHIFT = 24
+TICKS_MASK = (1 << EXCEPTION_SHIFT) - 1
+
+SAMPLE_STRUCT = struct.Struct("<III")
+SAMPLE_RTI_SHIFT = 20
+SAMPLE_OFFSET_MASK = (1 << SAMPLE_RTI_SHIFT) - 1
+
+COMPACT_EXIT = 0x8000
+COMPACT_TIMESTAMP = 0x7FFF
+COMPACT_DEFINE = 0x7FFE
+COMPACT_RAW = 0x7FFD
+
+
+class ProfileFormatError(Exception):
+    pass
+
+
+@dataclass
+class ProfileHeader:
+    format: int
+    flags: int
+    write_index: int
+
+
+@dataclass
+class ProfileEvent:
+    # Function address with the Thumb bit cleared, or None for a compact exit whose entry was not captured
+    address: Optional[int]
+    is_exit: bool
+    # DWT cycle count. Compact captures only record absolute times when a delta overflows, so these start from 0
+    # and may be offset from the cycle counter. Events only record 24 bits, which are extended here.
+    ticks: int
+    # Exception number that was active (0 in thread mode), if recorded
+    exception: int = 0
+
+
+@dataclass
+class ProfileSample:
+    # Interrupted PC and LR with the Thumb bit cleared, or None if the sampling ISR couldn't find the frame
+    pc: Optional[int]
+    lr: Optional[int]
+    # Low 12 bits of the RTI index
+    rti: int
+    offset_us: int
+
+
+def parse_header(data: bytes) -> ProfileHeader:
+    if len(data) < HEADER_STRUCT.size:
+        raise ProfileFormatError("dump is too short to contain a header")
+    magic, fmt, flags, write_index = HEADER_STRUCT.unpack_from(data, 0)
+    if magic != HEADER_MAGIC:
+        raise ProfileFormatError(f"bad header magic 0x{magic:08X}")
+    return ProfileHeader(fmt, flags, write_index)
+
+
+def decode_events(data: bytes, header: ProfileHeader) -> List[ProfileEvent]:
+    body = data[HEADER_STRUCT.size :]
+    capacity = len(body) // EVENT_STRUCT.size
+    if header.write_index > capacity:
+        raise ProfileFormatError(
+            f"write index {header.write_index} is past the end of the region ({capacity} events)"
+        )
+
+    # Once the ring has wrapped, the oldest event is the one at the write index
+    if header.flags & FLAG_WRAPPED:
+        order = list(range(header.write_index, capacity)) + list(
+            range(header.write_index)
+        )
+    else:
+        order = range(header.write_index)
+
+    events = []
+    ticks = None
+    for index in order:
+        function_and_phase, second_word = EVENT_STRUCT.unpack_from(
+            body, index * EVENT_STRUCT.size
+        )
+        exception = second_word >> EXCEPTION_SHIFT
+        low_ticks = second_word & TICKS_MASK
+        if ticks is None:
+            ticks = low_ticks
+        else:
+            # Events are close to (but not exactly) in time order, so extend the 24-bit counter
+            # by the signed difference from the previous event
+            delta = (low_ticks - ticks) & TICKS_MASK
+            if delta >= 1 << (EXCEPTION_SHIFT - 1):
+                delta -= 1 << EXCEPTION_SHIFT
+            ticks += delta
+        events.append(
+            ProfileEvent(
+                function_and_phase & THUMB_MASK,
+                bool(function_and_phase & PHASE_FUNC_EXIT),
+                ticks,
+                exception,
+            )
+        )
+
+    # The hooks reserve events before reading the cycle counter, so an ISR that preempts a hook
+    # can leave its events ahead of the event that it interrupted
+    events.sort(key=lambda event: event.ticks)
+    return events
+
+
+def decode_compact(data: bytes, header: ProfileHeader) -> List[ProfileEvent]:
+    body = data[HEADER_STRUCT.size :]
+    count = header.write_index
+    if count * 2 > len(body):
+        raise ProfileFormatError(
+            f"write index {count} is past the end of the region ({len(body) // 2} halfwords)"
+        )
+    words = struct.unpack_from(f"<{count}H", body, 0)
+
+    def take(position: int, length: int):
+        if position + length > count:
+            raise ProfileFormatError(f"truncated record at halfword {position}")
+        return words[position : position + length]
+
+    functions = {}
+    # Exits don't record the function, so track the functions that have been entered
+    stack: List[Optional[int]] = []
+    events = []
+    ticks = 0
+    position = 0
+    while position < count:
+        word = words[position]
+        if word & COMPACT_EXIT:
+            ticks = (ticks + (word & ~COMPACT_EXIT)) & 0xFFFFFFFF
+            address = stack.pop() if stack else None
+            events.append(ProfileEvent(address, True, ticks))
+            position += 1
+        elif word == COMPACT_TIMESTAMP:
+            low, high = take(position + 1, 2)
+            ticks = low | (high << 16)
+            position += 3
+        elif word == COMPACT_DEFINE:
+            index, low, high = take(position + 1, 3)
+            functions[index] = (low | (high << 16)) & THUMB_MASK
+            position += 4
+        elif word == COMPACT_RAW:
+            low, high, delta = take(position + 1, 3)
+            ticks = (ticks + delta) & 0xFFFFFFFF
+            address = (low | (high << 16)) & THUMB_MASK
+            stack.append(address)
+            events.append(ProfileEvent(address, False, ticks))
+            position += 4
+        else:
+            (delta,) = take(position + 1, 1)
+            if word not in functions:
+                raise ProfileFormatError(
+                    f"function index {word} used before being defined at halfword {position}"
+                )
+            ticks = (ticks + delta) & 0xFFFFFFFF
+            address = functions[word]
+            stack.append(address)
+            events.append(ProfileEvent(address, False, ticks))
+            position += 2
+    return events
+
+
+def decode_samples(data: bytes, header: ProfileHeader) -> List[ProfileSample]:
+    body = data[HEADER_STRUCT.size :]
+    capacity = len(body) // SAMPLE_STRUCT.size
+    if header.write_index > capacity:
+        raise ProfileFormatError(
+            f"write index {header.write_index} is past the end of the region ({capacity} samples)"
+        )
+
+    samples = []
+    for index in range(header.write_index):
+        pc, lr, rti_and_offset = SAMPLE_STRUCT.unpack_from(
+            body, index * SAMPLE_STRUCT.size
+        )
+        samples.append(
+            ProfileSample(
+                (pc & ~1) if pc else None,
+                (lr & ~1) if pc else None,
+                rti_and_offset >> SAMPLE_RTI_SHIFT,
+                rti_and_offset & SAMPLE_OFFSET_MASK,
+            )
+        )
+    return samples
+
+
+def decode(data: bytes) -> Union[List[ProfileEvent], List[ProfileSample]]:
+    """Decode a dump of the whole profiler memory region"""
+    header = parse_header(data)
+    if header.flags & FLAG_RECORDING:
+        print(
+            "WARNING: the profiler was still recording, so the end of the capture is unknown",
+            file=sys.stderr,
+        )
+    if header.format == FORMAT_EVENT:
+        return decode_events(data, header)
+    if header.format == FORMAT_COMPACT:
+        return decode_compact(data, header)
+    if header.format == FORMAT_SAMPLE:
+        return decode_samples(data, header)
+    raise ProfileFormatError(f"unknown format {header.format}")
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Decode a dump of the Profiler memory region into CSV"
+    )
+    parser.add_argument("dump", help="Binary dump of the whole profiler memory region")
+    args = parser.parse_args()
+
+    with open(args.dump, "rb") as dump:
+        data = dump.read()
+    try:
+        events = decode(data)
+    except ProfileFormatError as e:
+        sys.exit(f"ERROR: {e}")
+
+    if events and isinstance(events[0], ProfileSample):
+        print("rti,offset_us,pc,lr")
+        for sample in events:
+            pc = "unknown" if sample.pc is None else f"0x{sample.pc:08X}"
+            lr = "unknown" if sample.lr is None else f"0x{sample.lr:08X}"
+            print(f"{sample.rti},{sample.offset_us},{pc},{lr}")
+        return
+
+    print("ticks,exception,phase,address")
+    for event in events:
+        address = "unknown" if event.address is None else f"0x{event.address:08X}"
+        phase = "exit" if event.is_exit else "enter"
+        print(f"{event.ticks},{event.exception},{phase},{address}")
+
+
+if __name__ == "__main__":
+    main()
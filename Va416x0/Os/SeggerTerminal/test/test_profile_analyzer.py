@@ -0,0 +1,267 @@
+# Copyright 2026 California Institute of Technology
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# SPDX-License-Identifier: Apache-2.0
+"""
+Tests for profile_analyzer.py, using synthetic dumps of the profiler memory region
+"""
+import csv
+import subprocess
+
+import pytest
+
+import Va416x0.Os.SeggerTerminal.profile_analyzer as profile_analyzer
+import Va416x0.Os.SeggerTerminal.profile_decode as profile_decode
+
+MAIN_LOOP = 0x1000
+HELPER = 0x1100
+ISR = 0x1200
+RTI_HANDLER = 0x1300
+
+# nm output for the functions above, with the Thumb bit set as in a real ELF
+NM_OUTPUT = f"""\
+{MAIN_LOOP | 1:08x} 00000100 T Va416x0Svc::MainLoop::execute_main_loop()
+{HELPER | 1:08x} 00000100 T helper(unsigned int)
+{ISR | 1:08x} 00000100 T arm_isr_16
+{RTI_HANDLER | 1:08x} 00000100 t {profile_analyzer.DEFAULT_RTI_FUNCTION}(long)
+"""
+
+MAIN_LOOP_NAME = "Va416x0Svc::MainLoop::execute_main_loop()"
+HELPER_NAME = "helper(unsigned int)"
+ISR_NAME = "arm_isr_16"
+
+
+@pytest.fixture
+def symbols(monkeypatch):
+    def fake_nm(command, **kwargs):
+        return subprocess.CompletedProcess(command, 0, stdout=NM_OUTPUT)
+
+    monkeypatch.setattr(profile_analyzer.subprocess, "run", fake_nm)
+    return profile_analyzer.SymbolTable("fsw.elf", "nm")
+
+
+def event_dump(events, flags=0):
+    """Build a region from (address, is_exit, ticks, exception) tuples"""
+    body = b""
+    for address, is_exit, ticks, exception in events:
+        function_and_phase = (address | 1) | (
+            profile_decode.PHASE_FUNC_EXIT if is_exit else 0
+        )
+        second_word = (exception << profile_decode.EXCEPTION_SHIFT) | (
+            ticks & profile_decode.TICKS_MASK
+        )
+        body += profile_decode.EVENT_STRUCT.pack(function_and_phase, second_word)
+    header = profile_decode.HEADER_STRUCT.pack(
+        profile_decode.HEADER_MAGIC, profile_decode.FORMAT_EVENT, flags, len(events)
+    )
+    return header + body
+
+
+def analyze(dump, symbols):
+    return profile_analyzer.analyze_events(profile_decode.decode(dump), symbols)
+
+
+def read_functions_csv(prefix):
+    with open(f"{prefix}.functions.csv", newline="") as report:
+        return {row["function"]: row for row in csv.DictReader(report)}
+
+
+def test_symbol_lookup(symbols):
+    assert symbols.lookup(MAIN_LOOP) == MAIN_LOOP_NAME
+    assert symbols.lookup(HELPER + 0x40) == HELPER_NAME
+    assert symbols.lookup(0x2000) == "0x00002000"
+    assert symbols.lookup(None) == profile_analyzer.UNKNOWN
+
+
+def test_nested_calls(symbols):
+    analysis = analyze(
+        event_dump(
+            [
+                (MAIN_LOOP, False, 0, 0),
+                (HELPER, False, 100, 0),
+                (HELPER, True, 400, 0),
+                (HELPER, False, 500, 0),
+                (HELPER, True, 600, 0),
+                (MAIN_LOOP, True, 1000, 0),
+            ]
+        ),
+        symbols,
+    )
+
+    assert analysis.total_cycles == 1000
+    main_loop = analysis.functions[MAIN_LOOP_NAME]
+    helper = analysis.functions[HELPER_NAME]
+    assert (main_loop.calls, main_loop.inclusive, main_loop.exclusive) == (1, 1000, 600)
+    assert (helper.calls, helper.inclusive, helper.exclusive) == (2, 400, 400)
+    assert analysis.folded[f"{MAIN_LOOP_NAME};{HELPER_NAME}"] == 400
+    assert analysis.folded[MAIN_LOOP_NAME] == 600
+
+
+def test_isr_time_is_not_charged_to_the_preempted_function(symbols):
+    analysis = analyze(
+        event_dump(
+            [
+                (MAIN_LOOP, False, 0, 0),
+                (ISR, False, 200, 16),
+                (ISR, True, 300, 16),
+                (MAIN_LOOP, True, 1000, 0),
+            ]
+        ),
+        symbols,
+    )
+
+    assert analysis.total_cycles == 1000
+    assert analysis.functions[MAIN_LOOP_NAME].exclusive == 900
+    assert analysis.functions[MAIN_LOOP_NAME].inclusive == 900
+    assert analysis.functions[ISR_NAME].exclusive == 100
+    assert analysis.folded[f"exception 16;{ISR_NAME}"] == 100
+    assert analysis.folded[MAIN_LOOP_NAME] == 900
+
+
+def test_isr_recorded_after_the_event_it_preempted(symbols):
+    # The ISR preempted the helper's entry hook after it reserved its event but before it read the cycle
+    # counter, so the ISR's events follow the helper entry in the region even though they happened first
+    analysis = analyze(
+        event_dump(
+            [
+                (MAIN_LOOP, False, 0, 0),
+                (HELPER, False, 160, 0),
+                (ISR, False, 100, 16),
+                (ISR, True, 150, 16),
+                (HELPER, True, 260, 0),
+                (MAIN_LOOP, True, 300, 0),
+            ]
+        ),
+        symbols,
+    )
+
+    assert analysis.functions[ISR_NAME].exclusive == 50
+    assert analysis.functions[HELPER_NAME].exclusive == 100
+    assert analysis.functions[MAIN_LOOP_NAME].exclusive == 150
+    assert analysis.total_cycles == 300
+
+
+def test_untraced_time(symbols):
+    analysis = analyze(
+        event_dump(
+            [
+                (HELPER, False, 0, 0),
+                (HELPER, True, 100, 0),
+                (HELPER, False, 400, 0),
+                (HELPER, True, 500, 0),
+            ]
+        ),
+        symbols,
+    )
+
+    assert analysis.total_cycles == 500
+    assert analysis.functions[HELPER_NAME].exclusive == 200
+    assert analysis.folded[profile_analyzer.UNTRACED] == 300
+
+
+def test_rti_breakdown(symbols):
+    analysis = analyze(
+        event_dump(
+            [
+                (RTI_HANDLER, False, 0, 20),
+                (RTI_HANDLER, True, 50, 20),
+                (MAIN_LOOP, False, 100, 0),
+                (MAIN_LOOP, True, 400, 0),
+                (RTI_HANDLER, False, 1000, 20),
+                (RTI_HANDLER, True, 1050, 20),
+                (MAIN_LOOP, False, 1100, 0),
+                (MAIN_LOOP, True, 1600, 0),
+            ]
+        ),
+        symbols,
+    )
+
+    assert sorted(analysis.rtis) == [1, 2]
+    assert analysis.rtis[1][MAIN_LOOP_NAME] == 300
+    assert analysis.rtis[2][MAIN_LOOP_NAME] == 500
+    assert analysis.functions[MAIN_LOOP_NAME].calls == 2
+
+
+def test_event_report_percentages(symbols, tmp_path):
+    analysis = analyze(
+        event_dump(
+            [
+                (MAIN_LOOP, False, 0, 0),
+                (HELPER, False, 250, 0),
+                (HELPER, True, 500, 0),
+                (ISR, False, 600, 16),
+                (ISR, True, 850, 16),
+                (MAIN_LOOP, True, 1000, 0),
+            ]
+        ),
+        symbols,
+    )
+    prefix = tmp_path / "profile"
+    profile_analyzer.write_event_reports(str(prefix), analysis, top=5)
+
+    rows = read_functions_csv(prefix)
+    assert rows[MAIN_LOOP_NAME]["exclusive_percent"] == "50.00"
+    assert rows[HELPER_NAME]["exclusive_percent"] == "25.00"
+    assert rows[ISR_NAME]["exclusive_percent"] == "25.00"
+    assert rows[MAIN_LOOP_NAME]["inclusive_cycles"] == "750"
+    assert (tmp_path / "profile.folded").read_text().splitlines() == [
+        f"{MAIN_LOOP_NAME} 500",
+        f"{MAIN_LOOP_NAME};{HELPER_NAME} 250",
+        f"exception 16;{ISR_NAME} 250",
+    ]
+
+
+def sample_dump(samples):
+    """Build a region from (pc, lr, rti, offset_us) tuples"""
+    body = b"".join(
+        profile_decode.SAMPLE_STRUCT.pack(
+            pc | 1 if pc else 0,
+            lr | 1 if lr else 0,
+            (rti << profile_decode.SAMPLE_RTI_SHIFT) | offset,
+        )
+        for pc, lr, rti, offset in samples
+    )
+    header = profile_decode.HEADER_STRUCT.pack(
+        profile_decode.HEADER_MAGIC, profile_decode.FORMAT_SAMPLE, 0, len(samples)
+    )
+    return header + body
+
+
+def test_sample_attribution(symbols, tmp_path):
+    samples = profile_decode.decode(
+        sample_dump(
+            [
+                (HELPER + 0x10, MAIN_LOOP + 0x20, 1, 100),
+                (HELPER + 0x14, MAIN_LOOP + 0x20, 1, 200),
+                (MAIN_LOOP + 0x30, 0x2000, 1, 300),
+                (0, 0, 2, 100),
+            ]
+        )
+    )
+    analysis = profile_analyzer.analyze_samples(samples, symbols)
+
+    assert analysis.total_samples == 4
+    assert analysis.functions[HELPER_NAME] == 2
+    assert analysis.functions[profile_analyzer.UNKNOWN] == 1
+    assert analysis.rtis[1][HELPER_NAME] == 2
+    assert analysis.rtis[2][profile_analyzer.UNKNOWN] == 1
+    assert analysis.folded[f"{MAIN_LOOP_NAME};{HELPER_NAME}"] == 2
+    assert analysis.folded[f"0x00002000;{MAIN_LOOP_NAME}"] == 1
+
+    prefix = tmp_path / "profile"
+    profile_analyzer.write_sample_reports(str(prefix), analysis, top=5)
+    rows = read_functions_csv(prefix)
+    assert rows[HELPER_NAME]["percent"] == "50.00"
+    assert rows[MAIN_LOOP_NAME]["percent"] == "25.00"
+    assert rows[profile_analyzer.UNKNOWN]["percent"] == "25.00"
@@ -0,0 +1,228 @@
+# Copyright 2026 California Institute of Technology
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# SPDX-License-Identifier: Apache-2.0
+"""
+Tests for profile_decode.py, using synthetic dumps of the profiler memory region
+"""
+import struct
+
+import pytest
+
+import Va416x0.Os.SeggerTerminal.profile_decode as profile_decode
+from Va416x0.Os.SeggerTerminal.profile_decode import ProfileEvent
+
+FUNCTION_A = 0x1000
+FUNCTION_B = 0x2000
+
+
+def header(fmt, write_index, flags=0):
+    return profile_decode.HEADER_STRUCT.pack(
+        profile_decode.HEADER_MAGIC, fmt, flags, write_index
+    )
+
+
+def event_word(address, is_exit):
+    return (address | 1) | (profile_decode.PHASE_FUNC_EXIT if is_exit else 0)
+
+
+def tagged_dump(events, flags=0, write_index=None):
+    """Build a FORMAT_EVENT region from (address, is_exit, ticks, exception) tuples"""
+    body = b"".join(
+        profile_decode.EVENT_STRUCT.pack(
+            event_word(address, is_exit),
+            (exception << profile_decode.EXCEPTION_SHIFT)
+            | (ticks & profile_decode.TICKS_MASK),
+        )
+        for address, is_exit, ticks, exception in events
+    )
+    if write_index is None:
+        write_index = len(events)
+    return header(profile_decode.FORMAT_EVENT, write_index, flags) + body
+
+
+def compact_dump(*records):
+    """Build a FORMAT_COMPACT region from records, each a list of halfwords"""
+    halfwords = [halfword for record in records for halfword in record]
+    body = struct.pack(f"<{len(halfwords)}H", *halfwords)
+    return header(profile_decode.FORMAT_COMPACT, len(halfwords)) + body
+
+
+def test_bad_magic():
+    data = struct.pack("<IIII", 0, profile_decode.FORMAT_EVENT, 0, 0)
+    with pytest.raises(profile_decode.ProfileFormatError, match="magic"):
+        profile_decode.decode(data)
+
+
+def test_write_index_past_the_end():
+    with pytest.raises(profile_decode.ProfileFormatError, match="past the end"):
+        profile_decode.decode(tagged_dump([(FUNCTION_A, False, 0, 0)], write_index=2))
+
+
+def test_24_bit_timestamps_are_extended():
+    # Each step is well under 2^23 cycles, but the capture spans several wraps of the 24-bit counter
+    step = 0x600000
+    ticks = [0xFFFF00 + step * index for index in range(8)]
+    events = profile_decode.decode(
+        tagged_dump(
+            [(FUNCTION_A, index % 2 == 1, tick, 0) for index, tick in enumerate(ticks)]
+        )
+    )
+
+    assert [event.ticks for event in events] == ticks
+    assert events[0] == ProfileEvent(FUNCTION_A, False, 0xFFFF00, 0)
+    assert events[1].is_exit
+
+
+def test_24_bit_extension_handles_small_backward_steps():
+    # An ISR's events can be recorded after a later timestamp, just across a wrap of the 24-bit counter
+    events = profile_decode.decode(
+        tagged_dump(
+            [
+                (FUNCTION_A, False, 0x1000010, 0),
+                (FUNCTION_B, False, 0x0FFFFF0, 16),
+                (FUNCTION_B, True, 0x1000008, 16),
+                (FUNCTION_A, True, 0x1000020, 0),
+            ]
+        )
+    )
+
+    # The extension starts from the low 24 bits of the first event in the region, so the ISR entry that
+    # happened before it, across the wrap, comes out negative
+    assert [event.ticks for event in events] == [-0x10, 0x08, 0x10, 0x20]
+    assert [event.address for event in events] == [
+        FUNCTION_B,
+        FUNCTION_B,
+        FUNCTION_A,
+        FUNCTION_A,
+    ]
+
+
+def test_preempting_isr_events_are_reordered():
+    # The ISR preempted the entry hook of FUNCTION_A between reserving its event and reading the cycle counter
+    events = profile_decode.decode(
+        tagged_dump(
+            [
+                (FUNCTION_A, False, 500, 0),
+                (FUNCTION_B, False, 200, 16),
+                (FUNCTION_B, True, 300, 16),
+                (FUNCTION_A, True, 900, 0),
+            ]
+        )
+    )
+
+    assert events == [
+        ProfileEvent(FUNCTION_B, False, 200, 16),
+        ProfileEvent(FUNCTION_B, True, 300, 16),
+        ProfileEvent(FUNCTION_A, False, 500, 0),
+        ProfileEvent(FUNCTION_A, True, 900, 0),
+    ]
+
+
+def test_wrapped_ring_starts_at_the_write_index():
+    # The region holds 4 events and the next one would have overwritten index 1
+    events = profile_decode.decode(
+        tagged_dump(
+            [
+                (FUNCTION_A, True, 400, 0),
+                (FUNCTION_A, False, 100, 0),
+                (FUNCTION_B, False, 200, 0),
+                (FUNCTION_B, True, 300, 0),
+            ],
+            flags=profile_decode.FLAG_RING | profile_decode.FLAG_WRAPPED,
+            write_index=1,
+        )
+    )
+
+    assert [(event.address, event.ticks) for event in events] == [
+        (FUNCTION_A, 100),
+        (FUNCTION_B, 200),
+        (FUNCTION_B, 300),
+        (FUNCTION_A, 400),
+    ]
+
+
+def test_compact_function_indices_are_resolved():
+    define = profile_decode.COMPACT_DEFINE
+    leave = profile_decode.COMPACT_EXIT
+    events = profile_decode.decode(
+        compact_dump(
+            # Define index 7 as FUNCTION_A (with the Thumb bit) and enter it 10 cycles in
+            [define, 7, FUNCTION_A | 1, 0],
+            [7, 10],
+            # Define index 3 as FUNCTION_B and enter it
+            [define, 3, FUNCTION_B | 1, 0],
+            [3, 20],
+            # Exit FUNCTION_B, then enter it again through its index
+            [leave | 5],
+            [3, 5],
+            [leave | 5],
+            # Exit FUNCTION_A
+            [leave | 100],
+        )
+    )
+
+    assert events == [
+        ProfileEvent(FUNCTION_A, False, 10),
+        ProfileEvent(FUNCTION_B, False, 30),
+        ProfileEvent(FUNCTION_B, True, 35),
+        ProfileEvent(FUNCTION_B, False, 40),
+        ProfileEvent(FUNCTION_B, True, 45),
+        ProfileEvent(FUNCTION_A, True, 145),
+    ]
+
+
+def test_compact_raw_entries_and_absolute_timestamps():
+    events = profile_decode.decode(
+        compact_dump(
+            [profile_decode.COMPACT_RAW, 0x5679, 0x0001, 10],
+            [profile_decode.COMPACT_TIMESTAMP, 0x0000, 0x0002],
+            [profile_decode.COMPACT_EXIT | 0],
+        )
+    )
+
+    assert events == [
+        ProfileEvent(0x15678, False, 10),
+        ProfileEvent(0x15678, True, 0x20000),
+    ]
+
+
+def test_compact_exit_without_entry_is_unattributed():
+    events = profile_decode.decode(compact_dump([profile_decode.COMPACT_EXIT | 50]))
+
+    assert events == [ProfileEvent(None, True, 50)]
+
+
+def test_compact_undefined_index():
+    with pytest.raises(profile_decode.ProfileFormatError, match="before being defined"):
+        profile_decode.decode(compact_dump([4, 10]))
+
+
+def test_compact_truncated_record():
+    with pytest.raises(profile_decode.ProfileFormatError, match="truncated"):
+        profile_decode.decode(compact_dump([profile_decode.COMPACT_DEFINE, 1, 0x1001]))
+
+
+def test_samples():
+    body = profile_decode.SAMPLE_STRUCT.pack(
+        FUNCTION_A | 1, FUNCTION_B | 1, (5 << profile_decode.SAMPLE_RTI_SHIFT) | 250
+    ) + profile_decode.SAMPLE_STRUCT.pack(
+        0, 0, (6 << profile_decode.SAMPLE_RTI_SHIFT) | 10
+    )
+    samples = profile_decode.decode(header(profile_decode.FORMAT_SAMPLE, 2) + body)
+
+    assert samples == [
+        profile_decode.ProfileSample(FUNCTION_A, FUNCTION_B, 5, 250),
+        profile_decode.ProfileSample(None, None, 6, 10),
+    ]
@@ -26,55 +26,55 @@ extern uint8_t __stack[];
 }
 
 void arm_isr_2(void) {
-    va416x0_vector_table_instance->handle_exception(2);
+    va416x0_vector_table_instance->handle_exception(2, 0, 0, nullptr);
 }
 
 void arm_isr_3(void) {
-    va416x0_vector_table_instance->handle_exception(3);
+    va416x0_vector_table_instance->handle_exception(3, 0, 0, nullptr);
 }
 
 void arm_isr_4(void) {
-    va416x0_vector_table_instance->handle_exception(4);
+    va416x0_vector_table_instance->handle_exception(4, 0, 0, nullptr);
 }
 
 void arm_isr_5(void) {
-    va416x0_vector_table_instance->handle_exception(5);
+    va416x0_vector_table_instance->handle_exception(5, 0, 0, nullptr);
 }
 
 void arm_isr_6(void) {
-    va416x0_vector_table_instance->handle_exception(6);
+    va416x0_vector_table_instance->handle_exception(6, 0, 0, nullptr);
 }
 
 void arm_isr_7(void) {
-    va416x0_vector_table_instance->handle_exception(7);
+    va416x0_vector_table_instance->handle_exception(7, 0, 0, nullptr);
 }
 
 void arm_isr_8(void) {
-    va416x0_vector_table_instance->handle_exception(8);
+    va416x0_vector_table_instance->handle_exception(8, 0, 0, nullptr);
 }
 
 void arm_isr_9(void) {
-    va416x0_vector_table_instance->handle_exception(9);
+    va416x0_vector_table_instance->handle_exception(9, 0, 0, nullptr);
 }
 
 void arm_isr_10(void) {
-    va416x0_vector_table_instance->handle_exception(10);
+    va416x0_vector_table_instance->handle_exception(10, 0, 0, nullptr);
 }
 
 void arm_isr_11(void) {
-    va416x0_vector_table_instance->handle_exception(11);
+    va416x0_vector_table_instance->handle_exception(11, 0, 0, nullptr);
 }
 
 void arm_isr_12(void) {
-    va416x0_vector_table_instance->handle_exception(12);
+    va416x0_vector_table_instance->handle_exception(12, 0, 0, nullptr);
 }
 
 void arm_isr_13(void) {
-    va416x0_vector_table_instance->handle_exception(13);
+    va416x0_vector_table_instance->handle_exception(13, 0, 0, nullptr);
 }
 
 void arm_isr_14(void) {
-    va416x0_vector_table_instance->handle_exception(14);
+    va416x0_vector_table_instance->handle_exception(14, 0, 0, nullptr);
 }
 
 void systick_handler(void);
@@ -20,11 +20,17 @@
 // ======================================================================
 
 #include "Va416x0/Svc/MainLoop/MainLoop.hpp"
+#include <cstring>
+#include "Fw/Log/LogString.hpp"
+#include "Va416x0/Mmio/Amba/Amba.hpp"
 #include "Va416x0/Mmio/ClkGen/ClkGen.hpp"
 #include "Va416x0/Mmio/ClkTree/ClkTree.hpp"
 #include "Va416x0/Mmio/Cpu/Cpu.hpp"
+#include "Va416x0/Mmio/Dwt/Dwt.hpp"
 #include "Va416x0/Mmio/SysConfig/SysConfig.hpp"
+#include "Va416x0/Mmio/SysControl/SysControl.hpp"
 #include "Va416x0/Mmio/Timer/Timer.hpp"
+#include "Va416x0/Os/IsrSafeQueue/IsrSafeQueue.hpp"
 #include "fprime-baremetal/Os/TaskRunner/TaskRunner.hpp"
 
 namespace Va416x0Svc {
@@ -34,6 +40,7 @@ namespace Va416x0Svc {
 // ----------------------------------------------------------------------
 MainLoop ::MainLoop(const char* const compName) : MainLoopComponentBase(compName) {
     FW_ASSERT(this->m_readyToRun.is_lock_free());
+    this->clear_performance_window();
 }
 
 void MainLoop ::configure(Va416x0Mmio::ClkTree system_clk_configuration,
@@ -44,6 +51,107 @@ void MainLoop ::configure(Va416x0Mmio::ClkTree system_clk_configuration,
     this->m_enablePerformanceTest = enable_performance;
     this->m_dispatchPerRti = dispatch_per_rti;
     FW_ASSERT(this->m_readyToRun.is_lock_free());
+
+    // The cycle counter is enabled by _start
+    FW_ASSERT(Va416x0Mmio::Dwt::is_cycle_counter_enabled());
+
+    if (enable_performance) {
+        Va416x0Os::IsrSafeQueue::IsrSafeQueue::setReceiveObserver(MainLoop::on_queue_receive, this);
+    }
+}
+
+void MainLoop ::set_overrun_policy(MlOverrunPolicy policy) {
+    FW_ASSERT(policy.isValid(), policy);
+    this->m_overrunPolicy = policy;
+}
+
+void MainLoop ::configure_rate_group_shedding(FwIndexType shed_ports) {
+    FW_ASSERT(0 < shed_ports && shed_ports < NUM_CYCLE_OUTPUT_PORTS, shed_ports);
+    this->m_shedPorts = shed_ports;
+}
+
+void MainLoop ::configure_rti_stretch(const MetronomeConfig& metronome_config,
+                                      U32 nominal_micros,
+                                      U32 stretched_micros,
+                                      U32 recovery_rtis) {
+    FW_ASSERT(metronome_config.minimum_duration_micros <= nominal_micros, nominal_micros,
+              metronome_config.minimum_duration_micros);
+    FW_ASSERT(nominal_micros < stretched_micros, nominal_micros, stretched_micros);
+    FW_ASSERT(stretched_micros <= metronome_config.maximum_duration_micros, stretched_micros,
+              metronome_config.maximum_duration_micros);
+    FW_ASSERT(recovery_rtis > 0);
+    this->m_nominalDurationMicros = nominal_micros;
+    this->m_stretchedDurationMicros = stretched_micros;
+    this->m_stretchRecoveryRtis = recovery_rtis;
+}
+
+void MainLoop ::set_dispatch_budget(const char* queue_name, U32 budget_cycles) {
+    FW_ASSERT(queue_name != nullptr);
+    FW_ASSERT(this->m_numTaskSlots < ML_MAX_TIMED_TASKS, this->m_numTaskSlots);
+    TaskTiming& task = this->m_taskTiming[this->m_numTaskSlots];
+    task.name = queue_name;
+    task.budget = budget_cycles;
+    this->m_numTaskSlots++;
+}
+
+void MainLoop ::set_idle_mode(IdleMode mode) {
+    FW_ASSERT(mode == IDLE_WFI || mode == IDLE_SLEEP_ON_EXIT, mode);
+    this->m_idleMode = mode;
+    this->m_requestedIdleMode = mode;
+    this->m_sleepOnExitConfigured = (mode == IDLE_SLEEP_ON_EXIT);
+}
+
+void MainLoop ::set_dispatch_mode(DispatchMode mode, U32 safety_margin_micros) {
+    FW_ASSERT(mode == DISPATCH_FIXED || mode == DISPATCH_WORK_CONSERVING, mode);
+    this->m_dispatchMode = mode;
+    this->m_dispatchMarginMicros = safety_margin_micros;
+}
+
+// ----------------------------------------------------------------------
+// Performance tracking helpers
+// ----------------------------------------------------------------------
+
+void MainLoop::StageStats ::reset() {
+    this->last = 0;
+    this->min = 0xFFFFFFFF;
+    this->max = 0;
+    this->total = 0;
+    this->count = 0;
+}
+
+void MainLoop::StageStats ::record(U32 cycles) {
+    this->last = cycles;
+    if (cycles < this->min) {
+        this->min = cycles;
+    }
+    if (cycles > this->max) {
+        this->max = cycles;
+    }
+    this->total += cycles;
+    this->count++;
+}
+
+Va416x0::MlStageStats MainLoop::StageStats ::to_port() const {
+    U32 mean = 0;
+    if (this->count != 0) {
+        mean = static_cast<U32>(this->total / this->count);
+    }
+    return Va416x0::MlStageStats(this->last, this->min, this->max, mean);
+}
+
+U32 MainLoop::FrameUtilization ::load_permille() const {
+    if (this->frame == 0) {
+        return 0;
+    }
+    return static_cast<U32>((static_cast<U64>(this->frame - this->idle) * 1000) / this->frame);
+}
+
+MlUtilization MainLoop::FrameUtilization ::to_port() const {
+    VtPriorityCycles isr_cycles;
+    for (FwSizeType level = 0; level < VtPriorityCycles::SIZE; level++) {
+        isr_cycles[level] = this->isr[level];
+    }
+    return MlUtilization(this->frame, this->main_loop, isr_cycles, this->idle, this->load_permille());
 }
 
 // ----------------------------------------------------------------------
@@ -51,13 +159,34 @@ void MainLoop ::configure(Va416x0Mmio::ClkTree system_clk_configuration,
 // ----------------------------------------------------------------------
 
 void MainLoop ::reset_vector_handler(FwIndexType portNum) {
+    // Check the overrun policy now rather than at the first overrun, which is
+    // exactly when STRETCH_RTI is meant to keep running.
+    if (this->m_overrunPolicy == MlOverrunPolicy::STRETCH_RTI) {
+        FW_ASSERT(this->m_stretchedDurationMicros != 0);
+        FW_ASSERT(this->isConnected_updateDuration_OutputPort(0));
+    }
+
     this->enable_irq_router();
+
+    if (this->m_idleMode == IDLE_SLEEP_ON_EXIT) {
+        // PendSV must be ready before the Metronome starts, since the first
+        // RTI can begin as soon as it does.
+        this->prepare_sleep_on_exit();
+    }
+
     this->invoke_start_ports();
 
     // Flight software main loop for the main thread
     while (true) {
+        if (this->m_idleMode == IDLE_SLEEP_ON_EXIT) {
+            // Only returns once an idle mode comparison switches to IDLE_WFI
+            this->sleep_on_exit();
+        }
         this->wait_for_next_rti();
         this->execute_main_loop();
+        if (this->m_requestedIdleMode == IDLE_SLEEP_ON_EXIT) {
+            this->enter_sleep_on_exit();
+        }
     }
 }
 
@@ -78,151 +207,699 @@ void MainLoop ::invoke_start_ports() {
     start_metronome_out(0);
 }
 
+void MainLoop ::prepare_sleep_on_exit() {
+    // Give PendSV the lowest possible priority so that every other exception
+    // can preempt the main loop body, just like they can preempt thread mode.
+    U32 shpr3 = Va416x0Mmio::SysControl::read_shpr3();
+    shpr3 |= Va416x0Mmio::SysControl::SHPR3_PRI_14_MASK;
+    Va416x0Mmio::SysControl::write_shpr3(shpr3);
+    Va416x0Mmio::Amba::memory_barrier();
+}
+
+void MainLoop ::sleep_on_exit() {
+    // From now on, every exception that returns to thread mode puts the core
+    // straight back to sleep instead of resuming this loop. There's no race
+    // with the RTI ISR here: it pends PendSV rather than waking this thread.
+    U32 scr = Va416x0Mmio::SysControl::read_scr();
+    scr |= Va416x0Mmio::SysControl::SCR_SLEEPONEXIT;
+    Va416x0Mmio::SysControl::write_scr(scr);
+    Va416x0Mmio::Amba::memory_barrier();
+
+    // The core only resumes this loop once PendSV has cleared SLEEPONEXIT.
+    while (this->m_idleMode == IDLE_SLEEP_ON_EXIT) {
+        Va416x0Mmio::Cpu::waitForInterrupt();
+    }
+}
+
+void MainLoop ::leave_sleep_on_exit() {
+    // Called at the end of the main loop body in PendSV. The mode changes
+    // first, so an RTI from here on leaves its notification for
+    // wait_for_next_rti instead of pending PendSV.
+    this->m_idleMode = IDLE_WFI;
+    U32 scr = Va416x0Mmio::SysControl::read_scr();
+    scr &= ~Va416x0Mmio::SysControl::SCR_SLEEPONEXIT;
+    Va416x0Mmio::SysControl::write_scr(scr);
+    Va416x0Mmio::Amba::memory_barrier();
+}
+
+void MainLoop ::enter_sleep_on_exit() {
+    // Called at the end of the main loop body in thread mode. An RTI that
+    // started after wait_for_next_rti last checked didn't pend PendSV, so
+    // pend it here on its behalf.
+    Va416x0Mmio::Cpu::disable_interrupts();
+    this->m_idleMode = IDLE_SLEEP_ON_EXIT;
+    if (this->m_readyToRun.load() != 0) {
+        Va416x0Mmio::SysControl::write_icsr(Va416x0Mmio::SysControl::ICSR_PENDSVSET);
+    }
+    Va416x0Mmio::Cpu::enable_interrupts();
+}
+
+void MainLoop ::pend_sv_handler(FwIndexType portNum) {
+    FW_ASSERT(this->m_idleMode == IDLE_SLEEP_ON_EXIT, this->m_idleMode);
+
+    // PendSV has the lowest priority, so the RTI ISR has always finished
+    // by the time we get here. The exchange is atomic, so there's no need to
+    // disable interrupts.
+    const U32 rti_start = this->m_rtiStartCycles;
+    const U32 ready_to_run_value = this->m_readyToRun.exchange(0);
+
+    // Make sure we didn't slip any RTIs.
+    this->check_rti_ready(ready_to_run_value);
+
+    if (this->m_enablePerformanceTest) {
+        this->record_rti_performance(rti_start);
+    }
+
+    this->execute_main_loop();
+
+    if (this->m_requestedIdleMode == IDLE_WFI) {
+        this->leave_sleep_on_exit();
+    }
+}
+
 void MainLoop ::resetCounts_handler(FwIndexType portNum) {
     this->reset_performance_counts();
+    this->log_WARNING_HI_RtiOverrun_ThrottleClear();
+    this->log_WARNING_LO_TaskBudgetExceeded_ThrottleClear();
 }
 
 void MainLoop ::reset_performance_counts() {
     Va416x0Mmio::Cpu::disable_interrupts();
-    this->m_performanceResults.counter = 0xFFFFFFFF;
-    this->m_performanceResults.last = 0;
-    this->m_performanceResults.hwm = 0xFFFFFFFF;
-    this->m_performanceResults.lwm = 0xFFFFFFFF;
-    this->m_performanceResults.rti_count = 0;
-    this->m_performanceResults.counter_running_total = 0;
+    this->m_rtiCount = 0;
+    this->m_performanceResults.rti_cycles = 0;
+    this->m_performanceResults.dispatch_passes = 0;
+    this->m_performanceResults.dispatch_margin_stops = 0;
+    this->m_performanceResults.overrun_count = 0;
+    this->m_performanceResults.missed_rti_count = 0;
+    this->m_performanceResults.max_overrun_lateness = 0;
+    this->clear_performance_window();
+    for (FwIndexType slot = 0; slot < this->m_numTaskSlots; slot++) {
+        this->m_taskTiming[slot].last = 0;
+        this->m_taskTiming[slot].hwm = 0;
+        this->m_taskTiming[slot].violations = 0;
+    }
+    this->m_utilizationTotals = {};
+    this->m_utilizationWorst = {};
     Va416x0Mmio::Cpu::enable_interrupts();
 }
 
 U32 MainLoop ::getRti_handler(FwIndexType portNum) {
-    return this->m_performanceResults.rti_count;
+    return this->m_rtiCount;
 }
 
-MlPerformanceCounts MainLoop ::getCounts_handler(FwIndexType portNum) {
-    Va416x0Mmio::Cpu::disable_interrupts();
-    MlPerformanceCounts perf =
-        MlPerformanceCounts(this->m_performanceResults.counter, this->m_performanceResults.last,
-                            this->m_performanceResults.hwm, this->m_performanceResults.lwm,
-                            this->m_performanceResults.rti_count, this->m_performanceResults.counter_running_total);
-    Va416x0Mmio::Cpu::enable_interrupts();
-    return perf;
+Va416x0::MlPerformanceCounts MainLoop ::getCounts_handler(FwIndexType portNum) {
+    const PerformanceCounts counts = this->get_performance_counts();
+
+    Va416x0::MlSlackHistogram histogram;
+    for (FwSizeType bin = 0; bin < Va416x0::MlSlackHistogram::SIZE; bin++) {
+        histogram[bin] = counts.slack_histogram[bin];
+    }
+    return Va416x0::MlPerformanceCounts(counts.rti_count, counts.window_count, counts.rti_cycles,
+                                        counts.slack.to_port(), counts.wake.to_port(), counts.main_loop.to_port(),
+                                        counts.cycle.to_port(), counts.dispatch.to_port(), histogram,
+                                        counts.dispatch_passes, counts.dispatch_margin_stops, counts.overrun_count,
+                                        counts.missed_rti_count, counts.max_overrun_lateness);
 }
 
 MainLoop::PerformanceCounts MainLoop ::get_performance_counts() {
-    MainLoop::PerformanceCounts perf = {};
     Va416x0Mmio::Cpu::disable_interrupts();
-    perf.counter = this->m_performanceResults.counter;
-    perf.counter_running_total = this->m_performanceResults.counter_running_total;
-    perf.last = this->m_performanceResults.last;
-    perf.hwm = this->m_performanceResults.hwm;
-    perf.lwm = this->m_performanceResults.lwm;
-    perf.rti_count = this->m_performanceResults.rti_count;
+    MainLoop::PerformanceCounts perf = this->m_performanceResults;
+    perf.rti_count = this->m_rtiCount;
     Va416x0Mmio::Cpu::enable_interrupts();
     return perf;
 }
 
+void MainLoop ::Run_handler(FwIndexType portNum, U32 context) {
+    // Dispatch timing is only updated by the main loop, which also drives
+    // this port, so the table can be read directly.
+    MlTaskCycles last;
+    MlTaskCycles hwm;
+    MlTaskCounts violations;
+    for (FwIndexType slot = 0; slot < this->m_numTaskSlots; slot++) {
+        last[slot] = this->m_taskTiming[slot].last;
+        hwm[slot] = this->m_taskTiming[slot].hwm;
+        violations[slot] = this->m_taskTiming[slot].violations;
+    }
+    this->tlmWrite_TaskDispatchCycles(last);
+    this->tlmWrite_TaskDispatchHwm(hwm);
+    this->tlmWrite_TaskBudgetViolations(violations);
+
+    if (this->m_enablePerformanceTest && this->isConnected_getIrqCycles_OutputPort(0)) {
+        this->tlmWrite_UtilizationMean(this->m_utilizationMean.to_port());
+        this->tlmWrite_UtilizationWorst(this->m_utilizationWorst.to_port());
+    }
+}
+
+// ----------------------------------------------------------------------
+// Handler implementations for commands
+// ----------------------------------------------------------------------
+
+void MainLoop ::REPORT_TASK_BUDGETS_cmdHandler(FwOpcodeType opCode, U32 cmdSeq) {
+    for (FwIndexType slot = 0; slot < this->m_numTaskSlots; slot++) {
+        const TaskTiming& task = this->m_taskTiming[slot];
+        const Fw::LogStringArg name(task.name);
+        this->log_ACTIVITY_LO_TaskBudgetReport(static_cast<U32>(slot), name, task.hwm, task.budget, task.violations);
+    }
+
+    this->cmdResponse_out(opCode, cmdSeq, Fw::CmdResponse::OK);
+}
+
+void MainLoop ::COMPARE_IDLE_MODES_cmdHandler(FwOpcodeType opCode, U32 cmdSeq, U32 rtis) {
+    // Switching to IDLE_SLEEP_ON_EXIT needs the pend_sv port, which is only
+    // guaranteed to be connected when the deployment selected that mode.
+    if (!this->m_sleepOnExitConfigured || !this->m_enablePerformanceTest || this->m_comparePhase != COMPARE_NONE ||
+        rtis == 0) {
+        this->log_WARNING_LO_IdleModeComparisonUnavailable();
+        this->cmdResponse_out(opCode, cmdSeq, Fw::CmdResponse::VALIDATION_ERROR);
+        return;
+    }
+
+    // The deployment's own mode is measured first, starting with the next RTI
+    this->m_compareWake[IDLE_WFI] = {};
+    this->m_compareWake[IDLE_SLEEP_ON_EXIT] = {};
+    this->m_compareRtis = rtis;
+    this->m_compareRemaining = rtis;
+    this->m_comparePhase = COMPARE_SLEEP_ON_EXIT;
+
+    this->cmdResponse_out(opCode, cmdSeq, Fw::CmdResponse::OK);
+}
+
+void MainLoop ::record_idle_comparison(U32 wake) {
+    // The mode only changes at the end of a main loop body, so the current
+    // mode is the one this RTI woke up in.
+    WakeSummary& summary = this->m_compareWake[this->m_idleMode];
+    summary.total += wake;
+    if (wake > summary.max) {
+        summary.max = wake;
+    }
+
+    this->m_compareRemaining--;
+    if (this->m_compareRemaining > 0) {
+        return;
+    }
+
+    if (this->m_comparePhase == COMPARE_SLEEP_ON_EXIT) {
+        this->m_comparePhase = COMPARE_WFI;
+        this->m_compareRemaining = this->m_compareRtis;
+        this->m_requestedIdleMode = IDLE_WFI;
+        return;
+    }
+
+    const WakeSummary& wfi = this->m_compareWake[IDLE_WFI];
+    const WakeSummary& sleep = this->m_compareWake[IDLE_SLEEP_ON_EXIT];
+    this->log_ACTIVITY_HI_IdleModeComparison(this->m_compareRtis, static_cast<U32>(wfi.total / this->m_compareRtis),
+                                             wfi.max, static_cast<U32>(sleep.total / this->m_compareRtis), sleep.max);
+    this->m_comparePhase = COMPARE_NONE;
+    this->m_requestedIdleMode = IDLE_SLEEP_ON_EXIT;
+}
+
 void MainLoop ::start_rti_handler(FwIndexType portNum, U32 context) {
+    // Timestamp the start of the RTI as early as possible. The main thread
+    // does the rest of the bookkeeping so that this ISR stays short.
+    this->m_rtiStartCycles = Va416x0Mmio::Dwt::now_cycles();
+
     // Notify the main thread.
     // FIXME: Is there any chance of this getting dropped if a higher or equal priority ISR takes too long?
     // FIXME: Should we FATAL here rather than fataling in the main thread?
     this->m_readyToRun.fetch_add(1);
 
-    if (this->m_enablePerformanceTest) {
-        if (this->m_performanceResults.rti_count % 640 == 0) {
-            this->m_performanceResults.hwm = 0;
-            this->m_performanceResults.last = 0xFFFFFFFF;
-            this->m_performanceResults.lwm = 0xFFFFFFFF;
-        }
-        if (this->m_performanceResults.counter != 0xFFFFFFFF) {
-            this->m_performanceResults.counter_running_total += this->m_performanceResults.counter;
-            this->m_performanceResults.last = this->m_performanceResults.counter;
-            if (this->m_performanceResults.counter > this->m_performanceResults.hwm) {
-                this->m_performanceResults.hwm = this->m_performanceResults.counter;
-            }
-            if (this->m_performanceResults.counter < this->m_performanceResults.lwm) {
-                this->m_performanceResults.lwm = this->m_performanceResults.counter;
-            }
+    // Needed to drive telemetry collection schedules.
+    this->m_rtiCount = this->m_rtiCount + 1;
+
+    if (this->m_idleMode == IDLE_SLEEP_ON_EXIT) {
+        // The main loop body runs once every higher priority exception,
+        // including this one, has returned.
+        Va416x0Mmio::SysControl::write_icsr(Va416x0Mmio::SysControl::ICSR_PENDSVSET);
+    }
+}
+
+void MainLoop ::clear_performance_window() {
+    PerformanceCounts& perf = this->m_performanceResults;
+    perf.window_count = 0;
+    perf.slack.reset();
+    perf.wake.reset();
+    perf.main_loop.reset();
+    perf.cycle.reset();
+    perf.dispatch.reset();
+    for (U32& bin : perf.slack_histogram) {
+        bin = 0;
+    }
+}
+
+void MainLoop ::record_rti_performance(U32 rti_start) {
+    PerformanceCounts& perf = this->m_performanceResults;
+
+    if (perf.window_count >= PERFORMANCE_WINDOW_RTIS) {
+        this->clear_performance_window();
+    }
+
+    // The slack of the preceding RTI can only be computed now that we know
+    // when the current RTI started.
+    if (this->m_havePreviousRti) {
+        const U32 rti_cycles = rti_start - this->m_lastRtiStart;
+        const U32 slack = rti_start - this->m_previousLoopEnd;
+        perf.rti_cycles = rti_cycles;
+        perf.slack.record(slack);
+
+        FwSizeType bin = Va416x0::MlSlackHistogram::SIZE - 1;
+        if (slack < rti_cycles) {
+            bin = static_cast<FwSizeType>((static_cast<U64>(slack) * Va416x0::MlSlackHistogram::SIZE) / rti_cycles);
         }
+        perf.slack_histogram[bin]++;
+        perf.window_count++;
     }
+    this->m_lastRtiStart = rti_start;
+}
 
-    // Needed to drive telemetry collection schedules.
-    this->m_performanceResults.rti_count++;
+void MainLoop ::record_frame_start(U32 now) {
+    if (!this->isConnected_getIrqCycles_OutputPort(0)) {
+        return;
+    }
+    const VtPriorityCycles irq = this->getIrqCycles_out(0);
+
+    // The previous frame ends where this one starts. The exception totals
+    // wrap around, so only differences are used.
+    if (this->m_haveFrameStart) {
+        FrameUtilization frame;
+        frame.frame = now - this->m_frameStart;
+        U32 isr_total = 0;
+        U32 loop_isr_total = this->m_frameLoopEndIrqTotal;
+        for (FwSizeType level = 0; level < VtPriorityCycles::SIZE; level++) {
+            frame.isr[level] = irq[level] - this->m_frameStartIrq[level];
+            isr_total += frame.isr[level];
+            loop_isr_total -= this->m_frameStartIrq[level];
+        }
+
+        // The totals are read a few cycles apart from the timestamps, so
+        // clamp rather than let a small mismatch wrap around.
+        const U32 loop_cycles = this->m_frameLoopEnd - this->m_frameStart;
+        frame.main_loop = (loop_cycles > loop_isr_total) ? (loop_cycles - loop_isr_total) : 0;
+        const U32 busy = frame.main_loop + isr_total;
+        frame.idle = (frame.frame > busy) ? (frame.frame - busy) : 0;
+        this->record_utilization(frame);
+    }
+
+    this->m_frameStart = now;
+    for (FwSizeType level = 0; level < VtPriorityCycles::SIZE; level++) {
+        this->m_frameStartIrq[level] = irq[level];
+    }
+    this->m_haveFrameStart = true;
+}
+
+void MainLoop ::record_frame_end(U32 now) {
+    if (!this->isConnected_getIrqCycles_OutputPort(0)) {
+        return;
+    }
+    const VtPriorityCycles irq = this->getIrqCycles_out(0);
+
+    U32 irq_total = 0;
+    for (FwSizeType level = 0; level < VtPriorityCycles::SIZE; level++) {
+        irq_total += irq[level];
+    }
+    this->m_frameLoopEnd = now;
+    this->m_frameLoopEndIrqTotal = irq_total;
+}
+
+void MainLoop ::record_utilization(const FrameUtilization& frame) {
+    UtilizationTotals& totals = this->m_utilizationTotals;
+    totals.frame += frame.frame;
+    totals.main_loop += frame.main_loop;
+    for (FwSizeType level = 0; level < VtPriorityCycles::SIZE; level++) {
+        totals.isr[level] += frame.isr[level];
+    }
+    totals.idle += frame.idle;
+    totals.count++;
+
+    if (frame.load_permille() > this->m_utilizationWorst.load_permille()) {
+        this->m_utilizationWorst = frame;
+    }
+
+    // Publish the mean of each complete window, so that the telemetry always
+    // covers the same number of frames.
+    if (totals.count >= PERFORMANCE_WINDOW_RTIS) {
+        FrameUtilization& mean = this->m_utilizationMean;
+        mean.frame = static_cast<U32>(totals.frame / totals.count);
+        mean.main_loop = static_cast<U32>(totals.main_loop / totals.count);
+        for (FwSizeType level = 0; level < VtPriorityCycles::SIZE; level++) {
+            mean.isr[level] = static_cast<U32>(totals.isr[level] / totals.count);
+        }
+        mean.idle = static_cast<U32>(totals.idle / totals.count);
+        totals = {};
+    }
+}
+
+void MainLoop ::run_dispatch_pass(bool timed, U32& pass_start) {
+    Os::Baremetal::TaskRunner::getSingleton().runAll();
+
+    if (timed) {
+        const U32 pass_end = Va416x0Mmio::Dwt::now_cycles();
+        this->end_task_interval(pass_end);
+        this->m_performanceResults.dispatch.record(pass_end - pass_start);
+        pass_start = pass_end;
+    }
+}
+
+void MainLoop ::on_queue_receive(void* context, Va416x0Os::IsrSafeQueue::IsrSafeQueueHandle& handle) {
+    MainLoop* const self = static_cast<MainLoop*>(context);
+
+    // Only receives made by the TaskRunner mark the start of a dispatch. An
+    // ISR that consumes from a queue (such as an SPSC consumer) runs with a
+    // different active exception than the dispatch loop, whether that loop
+    // runs in thread mode or in PendSV.
+    if (!self->m_inDispatch || Va416x0Mmio::Cpu::get_active_exception() != self->m_dispatchException) {
+        return;
+    }
+
+    // A component that drains a queue from inside a handler, such as a queued
+    // component invoked through a port, receives deeper in the stack than the
+    // task that is already open. That time belongs to the open task. The
+    // TaskRunner may also dispatch a component deeper in the stack than the
+    // one before it, so each slot remembers the frame of its own top-level
+    // receive, learned whenever no task is open or the frame isn't deeper.
+    const uintptr_t frame = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+    const FwIndexType tag = handle.m_observerTag;
+    const bool known_top_level = tag >= 0 && tag != TASK_SLOT_UNTRACKED && self->m_taskTiming[tag].frame == frame;
+    const bool nested = self->m_currentTask != NO_TASK && frame < self->m_taskFrame;
+    if (nested && !known_top_level) {
+        return;
+    }
+
+    // Every top-level receive starts a new dispatch, so the time since the
+    // previous receive belongs to the previous component. This includes the
+    // TaskRunner's own overhead between the two.
+    self->end_task_interval(Va416x0Mmio::Dwt::now_cycles());
+
+    if (handle.m_observerTag < 0) {
+        handle.m_observerTag = self->assign_task_slot(handle);
+    }
+    if (handle.m_observerTag != TASK_SLOT_UNTRACKED) {
+        self->m_taskTiming[handle.m_observerTag].frame = frame;
+    }
+    self->m_currentTask = handle.m_observerTag;
+    self->m_taskFrame = frame;
+    self->m_taskStart = Va416x0Mmio::Dwt::now_cycles();
+}
+
+FwIndexType MainLoop ::assign_task_slot(const Va416x0Os::IsrSafeQueue::IsrSafeQueueHandle& handle) {
+    const Fw::LogStringArg name(handle.m_name);
+
+    // Slots with budgets were created up front, so look for ours first.
+    for (FwIndexType slot = 0; slot < this->m_numTaskSlots; slot++) {
+        if (::strcmp(this->m_taskTiming[slot].name, handle.m_name) == 0) {
+            this->log_ACTIVITY_LO_TaskSlotAssigned(static_cast<U32>(slot), name, this->m_taskTiming[slot].budget);
+            return slot;
+        }
+    }
+
+    if (this->m_numTaskSlots >= ML_MAX_TIMED_TASKS) {
+        this->log_WARNING_LO_TaskSlotsExhausted(name);
+        return TASK_SLOT_UNTRACKED;
+    }
+
+    const FwIndexType slot = this->m_numTaskSlots;
+    this->m_taskTiming[slot].name = handle.m_name;
+    this->m_taskTiming[slot].budget = 0;
+    this->m_numTaskSlots++;
+    this->log_ACTIVITY_LO_TaskSlotAssigned(static_cast<U32>(slot), name, 0);
+    return slot;
+}
+
+void MainLoop ::end_task_interval(U32 now) {
+    if (this->m_currentTask != NO_TASK && this->m_currentTask != TASK_SLOT_UNTRACKED) {
+        this->m_taskTiming[this->m_currentTask].rti_cycles += now - this->m_taskStart;
+    }
+    this->m_currentTask = NO_TASK;
+}
+
+void MainLoop ::record_task_timing() {
+    for (FwIndexType slot = 0; slot < this->m_numTaskSlots; slot++) {
+        TaskTiming& task = this->m_taskTiming[slot];
+        const U32 cycles = task.rti_cycles;
+        task.rti_cycles = 0;
+        task.last = cycles;
+        if (cycles > task.hwm) {
+            task.hwm = cycles;
+        }
+        if (task.budget != 0 && cycles > task.budget) {
+            task.violations++;
+            this->log_WARNING_LO_TaskBudgetExceeded(static_cast<U32>(slot), cycles, task.budget);
+        }
+    }
+}
+
+U32 MainLoop ::dispatch_work_conserving(bool timed, U32& pass_start) {
+    // The TaskRunner also runs tasks that don't wait on a queue, so every RTI
+    // gets at least one pass whatever the queues hold.
+    if (!this->isConnected_getQueueActivity_OutputPort(0)) {
+        this->run_dispatch_pass(timed, pass_start);
+        return 1;
+    }
+
+    U32 passes = 0;
+    Va416x0::QueueActivity before = this->getQueueActivity_out(0);
+    while (true) {
+        this->run_dispatch_pass(timed, pass_start);
+        passes++;
+
+        // Components that keep messaging each other, or an ISR that keeps
+        // sending, would otherwise keep the loop going until the RTI overruns
+        // when the time left can't be measured.
+        if (passes >= this->m_dispatchPerRti) {
+            break;
+        }
+
+        const Va416x0::QueueActivity after = this->getQueueActivity_out(0);
+        if (after.get_pending() == 0) {
+            break;
+        }
+        // Queued (rather than active) components are only drained by their
+        // own port handlers, so their messages can stay queued while every
+        // task is idle. If a whole pass neither received anything nor saw a
+        // new message arrive, no task has work left this RTI.
+        if (after.get_received() == before.get_received() && after.get_sent() == before.get_sent()) {
+            break;
+        }
+        before = after;
+
+        // Leave enough time before the next RTI for the pass we're about to
+        // start. A single pass is bounded by the longest dispatch of each
+        // active component, which is what the margin must cover.
+        if (this->isConnected_getRtiRemaining_OutputPort(0) &&
+            this->getRtiRemaining_out(0) <= this->m_dispatchMarginMicros) {
+            this->m_performanceResults.dispatch_margin_stops++;
+            break;
+        }
+    }
+    return passes;
 }
 
 void MainLoop ::ensure_rti_not_elapsed() {
     // Make sure that the next RTI hasn't started yet.
     U32 ready_to_run_value = this->m_readyToRun.load();
-    // FIXME: Do we really want to trigger an assertion here?
-    // Maybe it should just be a FATAL.
-    FW_ASSERT(ready_to_run_value == 0, ready_to_run_value);
-}
 
-// NOTE: marked with noinline so that it appears in profile traces
-__attribute__((noinline)) void MainLoop ::wait_for_next_rti() {
-    if (this->m_enablePerformanceTest) {
-        U32 i = 0;
-        do {
-            this->m_performanceResults.counter = i++;
-        } while (this->m_readyToRun.load() == 0);
+    if (ready_to_run_value == 0) {
+        // Once the load has recovered, return to the nominal RTI duration.
+        if (this->m_rtiStretched) {
+            this->m_cleanRtisSinceStretch++;
+            if (this->m_cleanRtisSinceStretch >= this->m_stretchRecoveryRtis) {
+                this->updateDuration_out(0, this->m_nominalDurationMicros);
+                this->m_rtiStretched = false;
+                this->log_ACTIVITY_HI_RtiStretchRecovered(this->m_nominalDurationMicros);
+            }
+        }
+        return;
+    }
+
+    if (this->m_overrunPolicy == MlOverrunPolicy::ASSERT) {
+        // FIXME: Do we really want to trigger an assertion here?
+        // Maybe it should just be a FATAL.
+        FW_ASSERT(ready_to_run_value == 0, ready_to_run_value);
+    }
+
+    // The next RTI has already started, so its start timestamp tells us how
+    // late we are.
+    const U32 lateness = Va416x0Mmio::Dwt::now_cycles() - this->m_rtiStartCycles;
+    this->m_performanceResults.overrun_count++;
+    if (lateness > this->m_performanceResults.max_overrun_lateness) {
+        this->m_performanceResults.max_overrun_lateness = lateness;
+    }
+
+    switch (this->m_overrunPolicy.e) {
+        case MlOverrunPolicy::SKIP_FRAME:
+            // Drop the RTI that started while we were running. We'll wait
+            // for the next one instead of starting this one late.
+            this->skip_pending_rti();
+            break;
+        case MlOverrunPolicy::SHED_RATE_GROUPS:
+            // Start the late RTI right away, but with less work in it.
+            this->m_shedNextFrame = true;
+            break;
+        case MlOverrunPolicy::STRETCH_RTI:
+            // Start the late RTI right away. The longer duration takes effect
+            // from the RTI after it.
+            if (!this->m_rtiStretched) {
+                this->updateDuration_out(0, this->m_stretchedDurationMicros);
+                this->m_rtiStretched = true;
+            }
+            this->m_cleanRtisSinceStretch = 0;
+            break;
+        default:
+            FW_ASSERT(0, this->m_overrunPolicy);
+            break;
+    }
+
+    this->log_WARNING_HI_RtiOverrun(lateness, ready_to_run_value, this->m_overrunPolicy);
+}
 
-        // Make sure we didn't slip any RTIs.
+void MainLoop ::check_rti_ready(U32 ready_to_run_value) {
+    if (this->m_overrunPolicy == MlOverrunPolicy::ASSERT) {
         // FIXME: Do we really want to trigger an assertion here?
         // Maybe it should just be a FATAL.
-        U32 ready_to_run_value = this->m_readyToRun.exchange(0);
         FW_ASSERT(ready_to_run_value == 1, ready_to_run_value);
-    } else {
-        // We need to disable interrupts before invoking WFI. This is because,
-        // if an interrupt occurs after reading ready_to_run and before
-        // executing WFI... WFI won't be able to detect the interrupt! This is
-        // a problem because we wouldn't wake up this main thread and wouldn't
-        // start executing the next RTI on time.
-
-        // FIXME: Should we use sleep-on-exit instead?
-        // Then we wouldn't need to disable interrupts...
-        Va416x0Mmio::Cpu::disable_interrupts();
+    }
+
+    // With a recovery policy in place, the overrun has already been handled
+    // at the end of the previous main loop. All we can do for RTIs that came
+    // and went since then is count them.
+    FW_ASSERT(ready_to_run_value >= 1, ready_to_run_value);
+    this->m_performanceResults.missed_rti_count += ready_to_run_value - 1;
+}
 
-        // All accesses to this atomic need to be while we have interrupts disabled.
-        // FIXME: Could we use a RELAXED memory order for this atomic?
-        U32 ready_to_run_value = this->m_readyToRun.exchange(0);
+void MainLoop ::skip_pending_rti() {
+    // Consume the pending RTI and, in sleep-on-exit mode, the PendSV that it
+    // requested. Both must happen together, or the RTI ISR could pend PendSV
+    // for an RTI we've already consumed.
+    Va416x0Mmio::Cpu::disable_interrupts();
+    if (this->m_idleMode == IDLE_SLEEP_ON_EXIT) {
+        Va416x0Mmio::SysControl::write_icsr(Va416x0Mmio::SysControl::ICSR_PENDSVCLR);
+    }
+    const U32 skipped = this->m_readyToRun.exchange(0);
+    Va416x0Mmio::Cpu::enable_interrupts();
 
-        // Wait for the ISR to notify us.
-        while (ready_to_run_value == 0) {
-            // Go to sleep to save power.
-            // If there's a pending interrupt, WFI will act as a NOP,
-            // so there's no race condition here.
-            Va416x0Mmio::Cpu::waitForInterrupt();
-            Va416x0Mmio::Cpu::enable_interrupts();
+    this->m_performanceResults.missed_rti_count += skipped;
+}
+
+void MainLoop ::invoke_cycle_ports(Os::RawTime& raw_time) {
+    FwIndexType connected = 0;
+    for (FwIndexType port = 0; port < NUM_CYCLE_OUTPUT_PORTS; port++) {
+        if (this->isConnected_cycle_OutputPort(port)) {
+            connected++;
+        }
+    }
 
-            // Interrupts are handled here: in particular, the RTI ISR!
+    // When shedding load, the lowest priority rate groups are dropped, but
+    // the highest priority one always runs.
+    FwIndexType to_run = connected;
+    if (this->m_shedNextFrame && connected > 1) {
+        to_run = (connected > this->m_shedPorts) ? connected - this->m_shedPorts : 1;
+    }
+    this->m_shedNextFrame = false;
 
-            Va416x0Mmio::Cpu::disable_interrupts();
-            // See whether it's the top of the next RTI yet.
-            ready_to_run_value = this->m_readyToRun.exchange(0);
+    for (FwIndexType port = 0; port < NUM_CYCLE_OUTPUT_PORTS && to_run > 0; port++) {
+        if (this->isConnected_cycle_OutputPort(port)) {
+            this->cycle_out(port, raw_time);
+            to_run--;
         }
+    }
+}
+
+// NOTE: marked with noinline so that it appears in profile traces
+__attribute__((noinline)) void MainLoop ::wait_for_next_rti() {
+    // We need to disable interrupts before invoking WFI. This is because,
+    // if an interrupt occurs after reading ready_to_run and before
+    // executing WFI... WFI won't be able to detect the interrupt! This is
+    // a problem because we wouldn't wake up this main thread and wouldn't
+    // start executing the next RTI on time.
+
+    // See IDLE_SLEEP_ON_EXIT for an alternative that doesn't need to
+    // disable interrupts.
+    Va416x0Mmio::Cpu::disable_interrupts();
+
+    // All accesses to this atomic need to be while we have interrupts disabled.
+    // FIXME: Could we use a RELAXED memory order for this atomic?
+    U32 ready_to_run_value = this->m_readyToRun.exchange(0);
 
+    // Wait for the ISR to notify us.
+    while (ready_to_run_value == 0) {
+        // Go to sleep to save power.
+        // If there's a pending interrupt, WFI will act as a NOP,
+        // so there's no race condition here.
+        Va416x0Mmio::Cpu::waitForInterrupt();
         Va416x0Mmio::Cpu::enable_interrupts();
 
-        // Make sure we didn't slip any RTIs.
-        // FIXME: Do we really want to trigger an assertion here?
-        // Maybe it should just be a FATAL.
-        FW_ASSERT(ready_to_run_value == 1, ready_to_run_value);
+        // Interrupts are handled here: in particular, the RTI ISR!
+
+        Va416x0Mmio::Cpu::disable_interrupts();
+        // See whether it's the top of the next RTI yet.
+        ready_to_run_value = this->m_readyToRun.exchange(0);
+    }
+
+    // The RTI ISR has run and we still have interrupts disabled, so the start
+    // timestamp can't be overwritten while we read it.
+    const U32 rti_start = this->m_rtiStartCycles;
+
+    Va416x0Mmio::Cpu::enable_interrupts();
+
+    // Make sure we didn't slip any RTIs.
+    this->check_rti_ready(ready_to_run_value);
+
+    if (this->m_enablePerformanceTest) {
+        this->record_rti_performance(rti_start);
     }
 }
 
 // NOTE: marked with noinline so that it appears in profile traces
 __attribute__((noinline)) void MainLoop ::execute_main_loop() {
+    // Keep the software extension of the cycle counter current. It takes a
+    // critical section, so it is read here rather than in the RTI ISR.
+    (void)Va416x0Mmio::Dwt::now_cycles64();
+
+    const bool timed = this->m_enablePerformanceTest;
+    const U32 loop_start = timed ? Va416x0Mmio::Dwt::now_cycles() : 0;
+    if (timed) {
+        const U32 wake = loop_start - this->m_lastRtiStart;
+        this->m_performanceResults.wake.record(wake);
+        if (this->m_comparePhase != COMPARE_NONE) {
+            this->record_idle_comparison(wake);
+        }
+        this->record_frame_start(loop_start);
+    }
+
     Os::RawTime raw_time;
     auto status = raw_time.now();
     FW_ASSERT(status == Os::RawTime::Status::OP_OK, status);
 
-    if (isConnected_cycle_OutputPort(0)) {
-        this->cycle_out(0, raw_time);
+    this->invoke_cycle_ports(raw_time);
+
+    U32 pass_start = 0;
+    if (timed) {
+        pass_start = Va416x0Mmio::Dwt::now_cycles();
+        this->m_performanceResults.cycle.record(pass_start - loop_start);
     }
 
-    // Need to run tasks multiple times, or they'll only be able to handle a single message.
-    // FIXME: Is this really the best approach?
-    FW_ASSERT(this->m_dispatchPerRti > 0);
-    for (U32 i = 0; i < this->m_dispatchPerRti; i++) {
-        Os::Baremetal::TaskRunner::getSingleton().runAll();
+    U32 passes = 0;
+    this->m_dispatchException = Va416x0Mmio::Cpu::get_active_exception();
+    this->m_inDispatch = timed;
+    if (this->m_dispatchMode == DISPATCH_WORK_CONSERVING) {
+        passes = this->dispatch_work_conserving(timed, pass_start);
+    } else {
+        // Need to run tasks multiple times, or they'll only be able to handle a single message.
+        FW_ASSERT(this->m_dispatchPerRti > 0);
+        for (U32 i = 0; i < this->m_dispatchPerRti; i++) {
+            this->run_dispatch_pass(timed, pass_start);
+        }
+        passes = this->m_dispatchPerRti;
+    }
+    this->m_inDispatch = false;
+    this->m_performanceResults.dispatch_passes = passes;
+
+    if (timed) {
+        this->record_task_timing();
+        // pass_start now holds the end of the final dispatch pass
+        this->m_performanceResults.main_loop.record(pass_start - loop_start);
+        this->m_previousLoopEnd = pass_start;
+        this->m_havePreviousRti = true;
+        this->record_frame_end(pass_start);
     }
 
     this->ensure_rti_not_elapsed();
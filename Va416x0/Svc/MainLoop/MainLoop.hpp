@@ -24,7 +24,9 @@
 
 #include <atomic>
 #include "Va416x0/Mmio/ClkTree/ClkTree.hpp"
+#include "Va416x0/Os/IsrSafeQueue/IsrSafeQueue.hpp"
 #include "Va416x0/Svc/MainLoop/MainLoopComponentAc.hpp"
+#include "Va416x0/Svc/Metronome/Metronome.hpp"
 #include "Va416x0/Types/Optional.hpp"
 
 namespace Va416x0Svc {
@@ -42,39 +44,181 @@ class MainLoop : public MainLoopComponentBase {
                    bool enable_performance = false,
                    U32 dispatch_per_rti = 4);
 
+    enum DispatchMode {
+        //! Call TaskRunner::runAll() exactly dispatch_per_rti times every RTI
+        DISPATCH_FIXED,
+        //! Call TaskRunner::runAll() at least once and at most dispatch_per_rti
+        //! times, stopping early once every queue is drained or the time left
+        //! in the RTI drops to the safety margin
+        DISPATCH_WORK_CONSERVING,
+    };
+
+    //! Select how the TaskRunner is driven each RTI. Work-conserving dispatch
+    //! reads the queue totals through the getQueueActivity port, and makes a
+    //! single pass if it is not connected. It measures the time left in the
+    //! RTI through the getRtiRemaining port; if that is not connected only the
+    //! queue totals are used.
+    void set_dispatch_mode(DispatchMode mode, U32 safety_margin_micros = 0);
+
+    enum IdleMode {
+        //! The main loop runs in thread mode and waits for each RTI in a
+        //! loop that disables interrupts around WFI
+        IDLE_WFI,
+        //! The main loop body runs in the PendSV handler at the lowest
+        //! exception priority, pended by the RTI ISR. Thread mode only
+        //! sleeps, and SCR.SLEEPONEXIT returns the core straight to sleep
+        //! after every ISR that doesn't preempt the main loop body.
+        IDLE_SLEEP_ON_EXIT,
+    };
+
+    //! Select how the main thread waits for the next RTI. Must be called
+    //! before the reset vector runs. IDLE_SLEEP_ON_EXIT requires the pend_sv
+    //! port to be connected to the VectorTable, and also allows the
+    //! COMPARE_IDLE_MODES command to switch between the two modes at runtime.
+    void set_idle_mode(IdleMode mode);
+
+    //! Select what happens when the next RTI starts before the main loop
+    //! finishes. The default, ASSERT, preserves the historical behavior.
+    //! STRETCH_RTI also requires configure_rti_stretch and a connected
+    //! updateDuration port, which the reset vector checks before starting.
+    void set_overrun_policy(MlOverrunPolicy policy);
+
+    //! Configure the SHED_RATE_GROUPS overrun policy. In a shed frame, the
+    //! shed_ports lowest priority connected cycle ports are not invoked. The
+    //! highest priority connected port always runs. Defaults to 1.
+    void configure_rate_group_shedding(FwIndexType shed_ports);
+
+    //! Configure the STRETCH_RTI overrun policy. After an overrun, the RTI
+    //! duration is set to stretched_micros through the updateDuration port.
+    //! It returns to nominal_micros once recovery_rtis consecutive RTIs
+    //! complete without an overrun. Both durations must be within the
+    //! duration limits of the Metronome configuration.
+    void configure_rti_stretch(const MetronomeConfig& metronome_config,
+                               U32 nominal_micros,
+                               U32 stretched_micros,
+                               U32 recovery_rtis);
+
+    //! Set the per-RTI dispatch budget, in CPU cycles, of the active component
+    //! whose queue is named queue_name. Task slots are assigned in the order
+    //! budgets are set, then to unbudgeted queues in the order they are first
+    //! dispatched. queue_name must outlive the component. Dispatch timing is
+    //! part of performance accounting, so it requires enable_performance.
+    void set_dispatch_budget(const char* queue_name, U32 budget_cycles);
+
     // ----------------------------------------------------------------------
     // struct & helper functions for performance tracking (requires setting ENABLE_PERFORMANCE_TEST to true)
     // ----------------------------------------------------------------------
-    struct PerformanceCounts {
-        // Each count represents approximately 11 CPU cycles, but this could vary
-        // based on how the compiler chooses to optimize the counter loop.
-        // Therefore, you should always check the number of cycles for your test.
-
-        // The amount of spare CPU time elapsed so far in the current RTI,
-        // neither consumed in the main loop nor consumed in any ISRs. Measured
-        // in counts.
-        U32 counter;
-        // The sum of all counter values seen in RTIs since the last reset
-        U32 counter_running_total;
-        // The amount of spare CPU time elapsed in the preceeding RTI.
+
+    //! Number of RTIs after which the min/max/mean statistics and the slack
+    //! histogram are automatically cleared.
+    static constexpr U32 PERFORMANCE_WINDOW_RTIS = 640;
+
+    //! Running statistics for one stage of the main loop. All durations are
+    //! measured in CPU cycles using the DWT cycle counter.
+    struct StageStats {
+        // Duration observed most recently
         U32 last;
-        // The highest value of 'counter' observed since the last automatic clear
-        // of the high water mark.
-        U32 hwm;
-        // The lowest value of 'counter' observed since the last automatic clear
-        // of the low water mark.
-        U32 lwm;
+        // Shortest duration observed since the last window reset
+        U32 min;
+        // Longest duration observed since the last window reset
+        U32 max;
+        // Sum of all durations observed since the last window reset
+        U64 total;
+        // Number of durations observed since the last window reset
+        U32 count;
+
+        void reset();
+        void record(U32 cycles);
+        Va416x0::MlStageStats to_port() const;
+    };
+
+    struct PerformanceCounts {
         // The total number of RTIs elapsed.
         U32 rti_count;
+        // The number of RTIs accumulated since the last window reset.
+        U32 window_count;
+        // The length of the preceding RTI.
+        U32 rti_cycles;
+        // The spare CPU time in each RTI, between the end of execute_main_loop()
+        // and the start of the next RTI. This includes time spent in ISRs
+        // while the main thread was sleeping.
+        StageStats slack;
+        // The latency from the start of the RTI until execute_main_loop()
+        // starts running. Use this to compare the idle modes.
+        StageStats wake;
+        // The time spent in execute_main_loop().
+        StageStats main_loop;
+        // The time spent invoking the cycle port.
+        StageStats cycle;
+        // The time spent in each TaskRunner::runAll() pass.
+        StageStats dispatch;
+        // Slack as a fraction of the RTI period, see MlSlackHistogram.
+        U32 slack_histogram[Va416x0::MlSlackHistogram::SIZE];
+        // The number of TaskRunner::runAll() passes made in the preceding RTI.
+        U32 dispatch_passes;
+        // The number of RTIs where work-conserving dispatch ran out of time
+        // with messages still queued.
+        U32 dispatch_margin_stops;
+        // The number of RTIs where the main loop was still running when the
+        // next RTI started.
+        U32 overrun_count;
+        // The number of RTIs that started and ended entirely while the main
+        // loop was still running.
+        U32 missed_rti_count;
+        // The furthest the main loop has run into the next RTI.
+        U32 max_overrun_lateness;
     };
 
-    //! Returns a pointer to the performance counts struct
+    //! Returns a copy of the performance counts struct
     PerformanceCounts get_performance_counts();
 
     //! Reset all performance tracking values to defaults
     void reset_performance_counts();
 
   private:
+    //! Cycles spent in each part of one frame, see MlUtilization
+    struct FrameUtilization {
+        U32 frame;
+        U32 main_loop;
+        U32 isr[VtPriorityCycles::SIZE];
+        U32 idle;
+
+        U32 load_permille() const;
+        MlUtilization to_port() const;
+    };
+
+    //! Sums of the frames recorded in the current performance window
+    struct UtilizationTotals {
+        U64 frame;
+        U64 main_loop;
+        U64 isr[VtPriorityCycles::SIZE];
+        U64 idle;
+        U32 count;
+    };
+
+    //! Dispatch timing for one active component
+    struct TaskTiming {
+        // Name of the component queue
+        const char* name;
+        // Per-RTI dispatch budget in cycles, or 0 if unbudgeted
+        U32 budget;
+        // Dispatch time accumulated so far in the current RTI
+        U32 rti_cycles;
+        // Dispatch time in the preceding RTI
+        U32 last;
+        // Per-RTI dispatch time high-water mark
+        U32 hwm;
+        // Number of RTIs where rti_cycles exceeded budget
+        U32 violations;
+        // Frame address of the observer at the task's top-level receive
+        uintptr_t frame;
+    };
+
+    //! Observer tag for queues that didn't get a task slot
+    static constexpr FwIndexType TASK_SLOT_UNTRACKED = ML_MAX_TIMED_TASKS;
+    //! No task is dispatching
+    static constexpr FwIndexType NO_TASK = -1;
+
     // ----------------------------------------------------------------------
     // Handler implementations for typed input ports
     // ----------------------------------------------------------------------
@@ -83,11 +227,15 @@ class MainLoop : public MainLoopComponentBase {
     void reset_vector_handler(FwIndexType portNum  //!< The port number
                               ) override;
 
+    //! Handler implementation for pend_sv
+    void pend_sv_handler(FwIndexType portNum  //!< The port number
+                         ) override;
+
     //! Handler implementation for start_rti
     void start_rti_handler(FwIndexType portNum,  //!< The port number
                            U32 context) override;
     //! Handler implementation for getCounters
-    MlPerformanceCounts getCounts_handler(FwIndexType portNum  //!< The port number
+    Va416x0::MlPerformanceCounts getCounts_handler(FwIndexType portNum  //!< The port number
                                           ) override;
 
     //! Handler implementation for resetCounters
@@ -98,18 +246,121 @@ class MainLoop : public MainLoopComponentBase {
     U32 getRti_handler(FwIndexType portNum  //!< The port number
                        ) override;
 
+    //! Handler implementation for Run
+    void Run_handler(FwIndexType portNum,  //!< The port number
+                     U32 context           //!< The call order
+                     ) override;
+
+    // ----------------------------------------------------------------------
+    // Handler implementations for commands
+    // ----------------------------------------------------------------------
+
+    //! Handler implementation for command REPORT_TASK_BUDGETS
+    void REPORT_TASK_BUDGETS_cmdHandler(FwOpcodeType opCode,  //!< The opcode
+                                        U32 cmdSeq            //!< The command sequence number
+                                        ) override;
+
+    //! Handler implementation for command COMPARE_IDLE_MODES
+    void COMPARE_IDLE_MODES_cmdHandler(FwOpcodeType opCode,  //!< The opcode
+                                       U32 cmdSeq,           //!< The command sequence number
+                                       U32 rtis              //!< Number of RTIs to measure in each mode
+                                       ) override;
+
     void enable_irq_router();
     void invoke_start_ports();
+    void prepare_sleep_on_exit();
+    void sleep_on_exit();
+    void leave_sleep_on_exit();
+    void enter_sleep_on_exit();
+    void record_idle_comparison(U32 wake);
     void wait_for_next_rti();
     void ensure_rti_not_elapsed();
+    void check_rti_ready(U32 ready_to_run_value);
+    void skip_pending_rti();
+    void invoke_cycle_ports(Os::RawTime& raw_time);
     void execute_main_loop();
+    void run_dispatch_pass(bool timed, U32& pass_start);
+    U32 dispatch_work_conserving(bool timed, U32& pass_start);
+    void clear_performance_window();
+    void record_rti_performance(U32 rti_start);
+    static void on_queue_receive(void* context, Va416x0Os::IsrSafeQueue::IsrSafeQueueHandle& handle);
+    FwIndexType assign_task_slot(const Va416x0Os::IsrSafeQueue::IsrSafeQueueHandle& handle);
+    void end_task_interval(U32 now);
+    void record_task_timing();
+    void record_frame_start(U32 now);
+    void record_frame_end(U32 now);
+    void record_utilization(const FrameUtilization& frame);
 
     Va416x0Types::Optional<Va416x0Mmio::ClkTree> m_systemClkConfiguration;
     std::atomic<U32> m_readyToRun;
     bool m_enablePerformanceTest;
     U32 m_dispatchPerRti;
+    DispatchMode m_dispatchMode = DISPATCH_FIXED;
+    U32 m_dispatchMarginMicros = 0;
+    // Read by the RTI ISR, and only changed at main loop boundaries
+    volatile IdleMode m_idleMode = IDLE_WFI;
+    volatile IdleMode m_requestedIdleMode = IDLE_WFI;
+    bool m_sleepOnExitConfigured = false;
+
+    // Idle mode comparison, only accessed from the main loop
+    enum IdleComparePhase {
+        COMPARE_NONE,
+        COMPARE_SLEEP_ON_EXIT,
+        COMPARE_WFI,
+    };
+    struct WakeSummary {
+        U64 total;
+        U32 max;
+    };
+    IdleComparePhase m_comparePhase = COMPARE_NONE;
+    U32 m_compareRtis = 0;
+    U32 m_compareRemaining = 0;
+    WakeSummary m_compareWake[2] = {};
+
+    // Overrun recovery
+    MlOverrunPolicy m_overrunPolicy = MlOverrunPolicy::ASSERT;
+    bool m_shedNextFrame = false;
+    FwIndexType m_shedPorts = 1;
+    bool m_rtiStretched = false;
+    U32 m_cleanRtisSinceStretch = 0;
+    U32 m_nominalDurationMicros = 0;
+    U32 m_stretchedDurationMicros = 0;
+    U32 m_stretchRecoveryRtis = 0;
+
+    // Written by the RTI ISR. The start timestamp is always recorded, since
+    // it is also needed to measure overrun lateness.
+    volatile U32 m_rtiCount = 0;
+    volatile U32 m_rtiStartCycles = 0;
+
+    // Only accessed from the main thread, except for the whole-struct copies
+    // taken with interrupts disabled
+    PerformanceCounts m_performanceResults = {};
+    // Timestamps of the preceding RTI, used to compute its slack once the next RTI starts
+    bool m_havePreviousRti = false;
+    U32 m_lastRtiStart = 0;
+    U32 m_previousLoopEnd = 0;
+
+    // Per-component dispatch timing, only accessed from the main thread
+    TaskTiming m_taskTiming[ML_MAX_TIMED_TASKS] = {};
+    FwIndexType m_numTaskSlots = 0;
+    FwIndexType m_currentTask = NO_TASK;
+    U32 m_taskStart = 0;
+    uintptr_t m_taskFrame = 0;
+    bool m_inDispatch = false;
+    // Active exception (IPSR) of the dispatch loop, 0 in thread mode
+    U32 m_dispatchException = 0;
 
-    volatile PerformanceCounts m_performanceResults = {0xFFFFFFFF, 0, 0, 0xFFFFFFFF, 0xFFFFFFFF, 0};
+    // Frame utilization, only accessed from the main thread. The exception
+    // totals are sampled at the start and end of each main loop body, so
+    // that the exceptions that preempted it can be told apart from idle time.
+    bool m_haveFrameStart = false;
+    U32 m_frameStart = 0;
+    U32 m_frameStartIrq[VtPriorityCycles::SIZE] = {};
+    U32 m_frameLoopEnd = 0;
+    U32 m_frameLoopEndIrqTotal = 0;
+    UtilizationTotals m_utilizationTotals = {};
+    FrameUtilization m_utilizationMean = {};
+    FrameUtilization m_utilizationWorst = {};
 };
 
 }  // namespace Va416x0Svc
@@ -28,7 +28,6 @@
 #include "Va416x0/Mmio/SysConfig/SysConfig.hpp"
 
 #include <arm_acle.h>
-#include <algorithm>
 
 namespace Va416x0Svc {
 
@@ -50,24 +49,38 @@ Metronome ::Metronome(const char* const compName, const MetronomeConfig& config)
     main_ic.set_interrupt_priority(config.main_timer_interrupt_priority);
     proxy_ic.set_interrupt_priority(config.proxy_timer_interrupt_priority);
 
-    // Sort the clients. That way, they can be specified in any order, but can
-    // be executed efficiently.
+    // The schedule was sorted and validated by buildMetronomeSchedule(),
+    // normally at compile time. Check it again in case it wasn't.
     for (U32 i = 0; i < MAX_CLIENTS; i++) {
-        FW_ASSERT(config.client_trigger_times_micros[i] < config.minimum_duration_micros, i,
-                  config.client_trigger_times_micros[i], config.minimum_duration_micros);
-        clients[i].trigger_time_micros = config.client_trigger_times_micros[i];
-        clients[i].portNum = i;
+        const U32 trigger_time_micros = config.schedule.trigger_time_micros[i];
+        FW_ASSERT(trigger_time_micros < config.minimum_duration_micros, i, trigger_time_micros,
+                  config.minimum_duration_micros);
+        FW_ASSERT(i == 0 || config.schedule.trigger_time_micros[i - 1] <= trigger_time_micros, i, trigger_time_micros);
+        // A period of 0 marks an unused client, which has a phase of 0
+        const U32 period_rtis = config.schedule.period_rtis[i];
+        const U32 phase_rtis = config.schedule.phase_rtis[i];
+        FW_ASSERT((period_rtis == 0) ? (phase_rtis == 0) : (phase_rtis < period_rtis), i, phase_rtis, period_rtis);
+        clients[i].trigger_time_micros = trigger_time_micros;
+        clients[i].portNum = config.schedule.port_num[i];
     }
-    // We don't need to worry about sorting performance since the number of
-    // clients is small and it happens during init, not during execution.
-    std::sort(std::begin(clients), std::end(clients), [](const MetronomeClientInfo& a, const MetronomeClientInfo& b) {
-        return a.trigger_time_micros < b.trigger_time_micros;
-    });
+
+    for (ClientTiming& timing : m_clientTiming) {
+        timing = {};
+        timing.min_lateness = 0xFFFFFFFF;
+    }
+
+    FW_ASSERT(1 <= config.schedule.major_frame_rtis && config.schedule.major_frame_rtis <= MET_MAX_MINOR_FRAMES,
+              config.schedule.major_frame_rtis);
 
     // Make extra sure we don't run anything until the first RTI starts.
-    execution_index = MAX_CLIENTS;
+    m_pendingClients = 0;
 
     this->m_rtiIndex = 0;
+    this->m_rtiOffsetBase = 0;
+    this->m_minorFrame = 0;
+    this->m_rtiSnapshots[0] = {0, 0};
+    this->m_rtiSnapshots[1] = {0, 0};
+    this->m_rtiGeneration = 0;
 }
 
 // ----------------------------------------------------------------------
@@ -96,13 +109,13 @@ void Metronome ::start_metronome_handler(FwIndexType portNum) {
     main_timer.write_csd_ctrl(0);
 
     // Use the default RTI duration for now.
-    U32 freq = Va416x0Mmio::ClkTree::getActiveTimerFreq(main_timer);
-    FW_ASSERT(freq % MICROSECONDS_PER_SECOND == 0, freq, MICROSECONDS_PER_SECOND);
-    cycles_per_microsecond = freq / MICROSECONDS_PER_SECOND;
+    this->set_cycles_per_microsecond(Va416x0Mmio::ClkTree::getActiveTimerFreq(main_timer));
     main_timer.write_rst_value(config.default_duration_micros * cycles_per_microsecond - 1);
 
     // We want to start the first RTI more or less immediately.
     main_timer.write_cnt_value(1);
+    this->m_rtiOffsetBase = 1;
+    this->publish_rti_snapshot();
 
     // We will use the proxy timer to trigger an ISR whenever the main timer's
     // counter passes certain thresholds.
@@ -112,6 +125,15 @@ void Metronome ::start_metronome_handler(FwIndexType portNum) {
     proxy_timer.write_cnt_value(0);
     proxy_timer.write_ctrl(Va416x0Mmio::Timer::CTRL_ENABLE | Va416x0Mmio::Timer::CTRL_IRQ_ENB);
 
+    // Only connected clients are ever scheduled, so the ISRs don't spend any
+    // time on the others.
+    m_connectedClients = 0;
+    for (U32 i = 0; i < MAX_CLIENTS; i++) {
+        if (isConnected_client_trigger_isr_OutputPort(clients[i].portNum)) {
+            m_connectedClients |= (1U << i);
+        }
+    }
+
     // Before we start the timer, mark the metronome as running so that times are considered valid.
     this->m_isRunning = true;
 
@@ -131,40 +153,185 @@ void Metronome ::update_duration_handler(FwIndexType portNum, U32 micros) {
 
     // Recalculate the number of cycles per microsecond, just in case it has changed.
     // FIXME: Is this really necessary?
-    U32 freq = Va416x0Mmio::ClkTree::getActiveTimerFreq(main_timer);
-    FW_ASSERT(freq % MICROSECONDS_PER_SECOND == 0, freq, MICROSECONDS_PER_SECOND);
-    cycles_per_microsecond = freq / MICROSECONDS_PER_SECOND;
+    const U32 freq = Va416x0Mmio::ClkTree::getActiveTimerFreq(main_timer);
+
+    // The top-of-RTI ISR reads the client offsets, so update them atomically.
+    Va416x0Mmio::Lock::CriticalSectionLock lock;
+    this->set_cycles_per_microsecond(freq);
 
     // The new duration won't take effect until next RTI.
     main_timer.write_rst_value(micros * cycles_per_microsecond - 1);
 }
 
+void Metronome ::set_cycles_per_microsecond(U32 freq) {
+    FW_ASSERT(freq % MICROSECONDS_PER_SECOND == 0, freq, MICROSECONDS_PER_SECOND);
+    const U32 cycles = freq / MICROSECONDS_PER_SECOND;
+    if (cycles == this->cycles_per_microsecond) {
+        return;
+    }
+    this->cycles_per_microsecond = cycles;
+    // The reciprocal of a 1 MHz clock doesn't fit in 32 bits, but
+    // cycles_to_micros doesn't need it then.
+    this->micros_per_cycle_q32 =
+        (cycles == 1) ? 0 : static_cast<U32>(((static_cast<U64>(1) << 32) + cycles - 1) / cycles);
+
+    // Convert the schedule to timer cycles once here, rather than at the top
+    // of every RTI.
+    for (MetronomeClientInfo& client : clients) {
+        client.trigger_offset_cycles = client.trigger_time_micros * cycles;
+    }
+    // Force the thresholds to be recomputed with the new offsets.
+    this->m_thresholdsRstValue = 0;
+
+    if (config.late_threshold_micros != 0) {
+        this->m_lateThresholdCycles = config.late_threshold_micros * cycles;
+    }
+}
+
+U32 Metronome ::cycles_to_micros(U32 cycles) const {
+    if (this->cycles_per_microsecond == 1) {
+        return cycles;
+    }
+    // Multiplying by the rounded-up reciprocal gives either the exact quotient
+    // or one more than it, because cycles is less than 2^32.
+    U32 micros = static_cast<U32>((static_cast<U64>(cycles) * this->micros_per_cycle_q32) >> 32);
+    if (micros * this->cycles_per_microsecond > cycles) {
+        micros--;
+    }
+    return micros;
+}
+
+void Metronome ::publish_rti_snapshot() {
+    // Only the top-of-RTI ISR (and start_metronome, before it is enabled)
+    // writes the snapshots, so there is never more than one writer.
+    const U32 generation = this->m_rtiGeneration.load(std::memory_order_relaxed) + 1;
+    this->m_rtiSnapshots[generation & 1] = {this->m_rtiIndex, this->m_rtiOffsetBase};
+    this->m_rtiGeneration.store(generation, std::memory_order_release);
+}
+
 Va416x0Types::RtiTimeWithValidity Metronome ::getRtiTime_handler(FwIndexType portNum) {
     Va416x0Types::RtiTimeWithValidity rtiTimeV{false, Va416x0Types::RtiTime{0, 0}};
     if (!this->m_isRunning) {
         rtiTimeV.set_isValid(false);
         return rtiTimeV;
     }
-    // Lock to make sure that m_rtiIndex, m_rtiOffsetBase, and the main timer value are consistent.
-    Va416x0Mmio::Lock::CriticalSectionLock lock;
+    Va416x0Mmio::Timer main_timer = this->config.main_timer;
+
+    // The snapshot, the counter, and the pending bit are read without masking
+    // interrupts. If the top-of-RTI ISR publishes a new snapshot in the middle
+    // of this, the generation changes and we read everything again. Since the
+    // ISR writes the copy that isn't in use, the copy we read is never torn,
+    // even when we are preempting the ISR itself.
+    U32 rtiIndex;
+    U32 elapsedCycles;
+    while (true) {
+        const U32 generation = this->m_rtiGeneration.load(std::memory_order_acquire);
+        const RtiSnapshot snapshot = this->m_rtiSnapshots[generation & 1];
+
+        // Reading the pending bit and the ISR state on both sides of the
+        // counter tells us which RTI the counter belongs to. If either
+        // changed, the RTI ended between the reads, so try again.
+        const bool pendingBefore = this->main_ic.is_interrupt_pending();
+        const U8 stateBefore = this->m_rtiIsrState.load(std::memory_order_acquire);
+        const U32 cntValue = main_timer.read_cnt_value();
+        const U8 stateAfter = this->m_rtiIsrState.load(std::memory_order_acquire);
+        const bool pendingAfter = this->main_ic.is_interrupt_pending();
+        if (pendingBefore != pendingAfter || stateBefore != stateAfter) {
+            continue;
+        }
 
-    U32 cntValue = this->config.main_timer.read_cnt_value();
-    // FIXME: I think there's a race condition here if we roll just over the end of the RTI
-    FW_ASSERT(!this->main_ic.is_interrupt_pending());
-    FW_ASSERT(cntValue <= this->m_rtiOffsetBase, this->m_rtiIndex, cntValue, this->m_rtiOffsetBase);
+        // The pending bit is cleared when the top-of-RTI ISR is entered, a
+        // little before its handler marks the RTI as started, and the handler
+        // marks itself idle a little before the ISR returns. If we preempted
+        // the ISR in either window, we can't tell which RTI the counter
+        // belongs to, so report the time as unavailable rather than guess.
+        if (!pendingAfter && stateAfter == RTI_ISR_IDLE &&
+            Va416x0Mmio::Nvic::is_interrupt_active(main_timer.get_timer_done_exception())) {
+            return rtiTimeV;
+        }
+
+        // The main timer may have already rolled over without the top-of-RTI
+        // ISR having published the next snapshot yet, either because it is
+        // still pending, or because it is running and we preempted it. Either
+        // way, the counter belongs to the next RTI and counts down from the
+        // reset value that is loaded now.
+        if (pendingAfter || stateAfter == RTI_ISR_STARTED) {
+            rtiIndex = snapshot.rti_index + 1;
+            elapsedCycles = main_timer.read_rst_value() - cntValue;
+        } else {
+            rtiIndex = snapshot.rti_index;
+            elapsedCycles = snapshot.offset_base - cntValue;
+        }
 
-    U32 offsetUs = this->m_rtiOffsetBase - this->config.main_timer.read_cnt_value();
-    offsetUs /= this->cycles_per_microsecond;
+        if (generation == this->m_rtiGeneration.load(std::memory_order_acquire)) {
+            break;
+        }
+    }
 
-    FW_ASSERT(offsetUs <= config.maximum_duration_micros, offsetUs, this->m_rtiOffsetBase,
-              config.maximum_duration_micros);
+    const U32 offsetUs = this->cycles_to_micros(elapsedCycles);
+    FW_ASSERT(offsetUs <= config.maximum_duration_micros, offsetUs, rtiIndex, config.maximum_duration_micros);
 
     rtiTimeV.set_isValid(true);
-    rtiTimeV.set_rtiTime(Va416x0Types::RtiTime{this->m_rtiIndex, offsetUs});
+    rtiTimeV.set_rtiTime(Va416x0Types::RtiTime{rtiIndex, offsetUs});
     return rtiTimeV;
 }
 
+U32 Metronome ::getRtiRemaining_handler(FwIndexType portNum) {
+    if (!this->m_isRunning) {
+        return 0;
+    }
+
+    // The main timer counts down to zero at the end of the RTI, so the
+    // counter value is the time remaining. No lock is needed because a single
+    // register read is always self-consistent.
+    U32 cntValue = this->config.main_timer.read_cnt_value();
+
+    // If the main timer has already rolled over but its ISR hasn't run yet,
+    // the counter is reporting the next RTI. There's no time left in this one.
+    if (this->main_ic.is_interrupt_pending()) {
+        return 0;
+    }
+
+    return this->cycles_to_micros(cntValue);
+}
+
+MetClientTiming Metronome ::getClientTiming_handler(FwIndexType portNum, FwIndexType client) {
+    FW_ASSERT(0 <= client && client < MAX_CLIENTS, client);
+
+    // The statistics are updated by the timer ISRs.
+    ClientTiming timing;
+    {
+        Va416x0Mmio::Lock::CriticalSectionLock lock;
+        timing = this->m_clientTiming[client];
+    }
+
+    MetLatenessHistogram histogram;
+    for (FwSizeType bin = 0; bin < MetLatenessHistogram::SIZE; bin++) {
+        histogram[bin] = timing.histogram[bin];
+    }
+    const U32 min_lateness = (timing.fire_count == 0) ? 0 : timing.min_lateness;
+    return MetClientTiming(timing.fire_count, timing.late_count, min_lateness, timing.max_lateness, histogram);
+}
+
+void Metronome ::Run_handler(FwIndexType portNum, U32 context) {
+    MetClientCounts max_lateness;
+    MetClientCounts late_count;
+    {
+        Va416x0Mmio::Lock::CriticalSectionLock lock;
+        for (FwIndexType client = 0; client < MAX_CLIENTS; client++) {
+            max_lateness[client] = this->m_clientTiming[client].max_lateness;
+            late_count[client] = this->m_clientTiming[client].late_count;
+        }
+    }
+    this->tlmWrite_ClientMaxLateness(max_lateness);
+    this->tlmWrite_ClientLateCount(late_count);
+}
+
 void Metronome ::main_timer_isr_handler(FwIndexType portNum) {
+    // Until the new RTI is published, getRtiTime must treat the counter as
+    // belonging to it.
+    this->m_rtiIsrState.store(RTI_ISR_STARTED, std::memory_order_release);
+
     // Ensure that proxy interrupt is disabled before we manually execute the
     // interrupt action.
     proxy_ic.set_interrupt_enabled(false);
@@ -178,15 +345,23 @@ void Metronome ::main_timer_isr_handler(FwIndexType portNum) {
     // Advance to the next RTI
     this->m_rtiIndex++;
     this->m_rtiOffsetBase = rst_value;
+    this->publish_rti_snapshot();
+    this->m_rtiIsrState.store(RTI_ISR_PUBLISHED, std::memory_order_release);
+    U32 minor_frame = this->m_minorFrame + 1;
+    if (minor_frame >= config.schedule.major_frame_rtis) {
+        minor_frame = 0;
+    }
+    this->m_minorFrame = minor_frame;
 
     // Service remaining clients until the end of the RTI.
     // Since we will have no more remaining clients, the proxy ISR will not be
     // re-enabled at this time.
     this->process_isrs_until(0 /* the end of the RTI */);
 
-    // Now that all clients have been serviced, start again.
-    FW_ASSERT(execution_index == MAX_CLIENTS, execution_index);
-    execution_index = 0;
+    // Now that all clients have been serviced, start again with the clients
+    // scheduled in this minor frame.
+    FW_ASSERT(m_pendingClients == 0, m_pendingClients);
+    m_pendingClients = config.schedule.minor_frame_clients[minor_frame] & m_connectedClients;
 
     if (this->isConnected_end_rti_OutputPort(0)) {
         this->end_rti_out(0, 0 /* ignored */);
@@ -196,9 +371,13 @@ void Metronome ::main_timer_isr_handler(FwIndexType portNum) {
     this->start_rti_out(0, 0 /* ignored */);
 
     // With the potentially updated RTI duration, figure out when the different
-    // events should trigger.
-    for (MetronomeClientInfo& client : clients) {
-        client.trigger_time_threshold = rst_value - client.trigger_time_micros * cycles_per_microsecond;
+    // events should trigger. The RTI duration rarely changes, so most RTIs
+    // can reuse the thresholds from the previous one.
+    if (rst_value != this->m_thresholdsRstValue) {
+        for (MetronomeClientInfo& client : clients) {
+            client.trigger_time_threshold = rst_value - client.trigger_offset_cycles;
+        }
+        this->m_thresholdsRstValue = rst_value;
     }
 
     // Trigger any events that should have already occurred and update the
@@ -207,9 +386,11 @@ void Metronome ::main_timer_isr_handler(FwIndexType portNum) {
 
     // Since we couldn't re-enable the proxy timer interrupt in the ISR handler,
     // we'll do it now.
-    if (execution_index < MAX_CLIENTS) {
+    if (m_pendingClients != 0) {
         proxy_ic.set_interrupt_enabled(true);
     }
+
+    this->m_rtiIsrState.store(RTI_ISR_IDLE, std::memory_order_release);
 }
 
 void Metronome ::proxy_timer_isr_handler(FwIndexType portNum) {
@@ -221,16 +402,19 @@ void Metronome ::proxy_timer_isr_handler(FwIndexType portNum) {
 }
 
 void Metronome ::process_isrs_until(U32 until_cnt_value) {
-    // FIXME: We probably need to verify the timeliness of scheduled interrupts.
-    // Too much of a delay, and it would interfere with the correctness of the FSW.
+    // Each client's lateness is recorded just before it is triggered, so that
+    // its statistics show whether it met its schedule under the actual load.
 
     Va416x0Mmio::Timer main_timer = config.main_timer;
-    // We cache 'execution_index' locally to indicate to the optimizer that it
+    // We cache 'm_pendingClients' locally to indicate to the optimizer that it
     // doesn't have to worry about any of the function calls below changing
-    // the index.
-    U32 index = execution_index;
+    // it. Clients are sorted by trigger time, so the lowest set bit is always
+    // the next client to trigger.
+    U32 pending = m_pendingClients;
+
+    while (pending != 0) {
+        const U32 index = static_cast<U32>(__builtin_ctz(pending));
 
-    while (index < MAX_CLIENTS) {
         // Has the next timer been reached yet?
         U32 threshold = clients[index].trigger_time_threshold;
         if (until_cnt_value > threshold) {
@@ -253,20 +437,52 @@ void Metronome ::process_isrs_until(U32 until_cnt_value) {
             break;
         }
 
-        // Trigger the client ISR.
-        if (isConnected_client_trigger_isr_OutputPort(clients[index].portNum)) {
-            this->client_trigger_isr_out(clients[index].portNum, 0 /* ignored */);
+        // Trigger the client ISR. Only connected clients are ever pending.
+        // The main timer counts down, so it has passed the threshold by
+        // threshold - cnt_value cycles. At the end of the RTI, or if the
+        // timer rolled over while we were busy, the counter has restarted
+        // from the reset value, so add the time that's passed since then.
+        const FwIndexType client_port = clients[index].portNum;
+        const U32 cnt_value = main_timer.read_cnt_value();
+        U32 lateness = threshold - cnt_value;
+        if (until_cnt_value == 0 || cnt_value > threshold) {
+            lateness = threshold + (this->m_rtiOffsetBase - cnt_value);
         }
-        index++;
+        this->record_lateness(client_port, lateness);
+
+        this->client_trigger_isr_out(client_port, 0 /* ignored */);
+
+        pending &= pending - 1;
     }
 
     // Disable the proxy interrupt if necessary, but never enable it; we could
     // race with the end-of-RTI interrupt if we do that.
-    if (index >= MAX_CLIENTS) {
+    if (pending == 0) {
         proxy_ic.set_interrupt_enabled(false);
     }
 
-    execution_index = index;
+    m_pendingClients = pending;
+}
+
+void Metronome ::record_lateness(FwIndexType portNum, U32 lateness) {
+    ClientTiming& timing = this->m_clientTiming[portNum];
+    timing.fire_count++;
+    if (lateness < timing.min_lateness) {
+        timing.min_lateness = lateness;
+    }
+    if (lateness > timing.max_lateness) {
+        timing.max_lateness = lateness;
+    }
+    if (lateness > this->m_lateThresholdCycles) {
+        timing.late_count++;
+    }
+
+    // Bin by the position of the highest set bit, which is a single CLZ.
+    U32 bin = (lateness == 0) ? 0 : 32 - static_cast<U32>(__builtin_clz(lateness));
+    if (bin >= MET_LATENESS_BINS) {
+        bin = MET_LATENESS_BINS - 1;
+    }
+    timing.histogram[bin]++;
 }
 
 }  // namespace Va416x0Svc
@@ -26,6 +26,7 @@
 #include "Va416x0/Mmio/Timer/Timer.hpp"
 #include "Va416x0/Svc/Metronome/FppConstantsAc.hpp"
 #include "Va416x0/Svc/Metronome/MetronomeComponentAc.hpp"
+#include "Va416x0/Svc/Metronome/MetronomeSchedule.hpp"
 
 #include <atomic>
 
@@ -39,12 +40,14 @@ struct MetronomeConfig {
     U32 default_duration_micros;
     U32 maximum_duration_micros;
 
-    // FIXME: Do we need some mechanism to verify that the clients are actually
-    // triggered within an acceptable delay of the expected times?
-    // NOTE: This is copied and sorted during initialization.
-    U32 client_trigger_times_micros[MAX_CLIENTS];
+    // NOTE: Build this with buildMetronomeSchedule(), see MetronomeSchedule.hpp.
+    MetronomeSchedule schedule;
     U8 main_timer_interrupt_priority;
     U8 proxy_timer_interrupt_priority;
+
+    // Clients triggered more than this long after their scheduled time are
+    // counted as late. 0 disables late counting.
+    U32 late_threshold_micros;
 };
 
 class Metronome : public MetronomeComponentBase {
@@ -72,26 +75,92 @@ class Metronome : public MetronomeComponentBase {
 
     Va416x0Types::RtiTimeWithValidity getRtiTime_handler(FwIndexType portNum) override;
 
+    //! Handler implementation for getRtiRemaining
+    U32 getRtiRemaining_handler(FwIndexType portNum) override;
+
     //! Handler implementation for proxy_timer_isr
     void proxy_timer_isr_handler(FwIndexType portNum) override;
 
+    //! Handler implementation for getClientTiming
+    MetClientTiming getClientTiming_handler(FwIndexType portNum, FwIndexType client) override;
+
+    //! Handler implementation for Run
+    void Run_handler(FwIndexType portNum, U32 context) override;
+
     void process_isrs_until(U32 until_cnt_value);
+    void set_cycles_per_microsecond(U32 freq);
+    U32 cycles_to_micros(U32 cycles) const;
+    void publish_rti_snapshot();
+    void record_lateness(FwIndexType portNum, U32 lateness);
 
     struct MetronomeClientInfo {
         U32 trigger_time_micros;
+        // trigger_time_micros converted to main timer cycles
+        U32 trigger_offset_cycles;
         U32 trigger_time_threshold;
         FwIndexType portNum;
     };
 
+    //! Trigger lateness of one client, in main timer cycles
+    struct ClientTiming {
+        U32 fire_count;
+        U32 late_count;
+        U32 min_lateness;
+        U32 max_lateness;
+        U32 histogram[MET_LATENESS_BINS];
+    };
+
+    //! Start of an RTI, as seen by getRtiTime
+    struct RtiSnapshot {
+        U32 rti_index;
+        //! Main timer reset value that the RTI started from
+        U32 offset_base;
+    };
+
     const MetronomeConfig config;
     const Va416x0Mmio::Nvic::InterruptControl main_ic;
     const Va416x0Mmio::Nvic::InterruptControl proxy_ic;
-    U32 cycles_per_microsecond;
+    U32 cycles_per_microsecond = 0;
+    //! ceil(2^32 / cycles_per_microsecond), used to avoid a division when converting cycles to microseconds
+    U32 micros_per_cycle_q32 = 0;
     MetronomeClientInfo clients[MAX_CLIENTS];
-    U32 execution_index;
+    //! Written by the timer ISRs, indexed by port number
+    ClientTiming m_clientTiming[MAX_CLIENTS];
+    //! late_threshold_micros converted to main timer cycles, or 0xFFFFFFFF if disabled
+    U32 m_lateThresholdCycles = 0xFFFFFFFF;
+    //! Bit N is set while entry N of clients still has to trigger in this RTI
+    U32 m_pendingClients;
+    //! Bit N is set if entry N of clients is connected
+    U32 m_connectedClients = 0;
+    //! Index of the current RTI within the major frame
+    U32 m_minorFrame;
     U32 m_rtiIndex;
     U32 m_rtiOffsetBase;
 
+    //! Copies of m_rtiIndex and m_rtiOffsetBase for getRtiTime. The top-of-RTI
+    //! ISR fills in the copy that isn't in use and then increments
+    //! m_rtiGeneration, whose low bit selects the copy in use. Readers never
+    //! have to mask interrupts.
+    RtiSnapshot m_rtiSnapshots[2];
+    std::atomic<U32> m_rtiGeneration;
+
+    //! Progress of the top-of-RTI ISR, so that getRtiTime can tell whether a
+    //! snapshot preempted mid-ISR is already the one for the new RTI
+    enum RtiIsrState : U8 {
+        //! The handler isn't running
+        RTI_ISR_IDLE,
+        //! The handler has started but not yet published the new RTI
+        RTI_ISR_STARTED,
+        //! The handler has published the new RTI
+        RTI_ISR_PUBLISHED,
+    };
+    std::atomic<U8> m_rtiIsrState{RTI_ISR_IDLE};
+
+    //! Main timer reset value that the client thresholds were computed for.
+    //! 0 is never a valid reset value, so it forces the thresholds to be
+    //! recomputed at the top of the next RTI.
+    U32 m_thresholdsRstValue = 0;
+
     //! Flag indicating the metronome has started
     bool m_isRunning = false;
 };
@@ -0,0 +1,153 @@
+// Copyright 2026 California Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// ======================================================================
+// \title  MetronomeSchedule.hpp
+// \brief  Header-only builder that sorts and validates a Metronome client schedule at compile time
+// ======================================================================
+
+#ifndef Va416x0_MetronomeSchedule_HPP
+#define Va416x0_MetronomeSchedule_HPP
+
+#include "Fw/Types/Assert.hpp"
+#include "Fw/Types/BasicTypes.h"
+#include "Va416x0/Svc/Metronome/FppConstantsAc.hpp"
+
+namespace Va416x0Svc {
+
+static_assert(MAX_CLIENTS <= 32, "Minor frame client masks are U32 bitmasks");
+
+//! Metronome clients in the order they trigger within each RTI
+//! Usage:
+//! - Build the schedule with buildMetronomeSchedule() into a constexpr
+//!   variable, so that a bad schedule fails to compile instead of asserting
+//!   at boot:
+//!   constexpr MetronomeSchedule SCHEDULE = buildMetronomeSchedule({...}, MIN_DURATION_MICROS);
+//! - Pass it to the Metronome through MetronomeConfig::schedule
+struct MetronomeSchedule {
+    //! Trigger time of each entry, in microseconds after the start of the RTI, in ascending order
+    U32 trigger_time_micros[MAX_CLIENTS];
+    //! client_trigger_isr port number of each entry
+    FwIndexType port_num[MAX_CLIENTS];
+    //! Each entry triggers in the RTIs where (RTI index % period) == phase,
+    //! or never if its period is 0
+    U32 period_rtis[MAX_CLIENTS];
+    U32 phase_rtis[MAX_CLIENTS];
+    //! Number of RTIs after which the pattern of minor frames repeats
+    U32 major_frame_rtis;
+    //! For each minor frame (RTI index % major_frame_rtis), bit N is set if
+    //! entry N triggers in that RTI
+    U32 minor_frame_clients[MET_MAX_MINOR_FRAMES];
+};
+
+//! Greatest common divisor, for computing the major frame length
+constexpr U32 metronomeScheduleGcd(U32 a, U32 b) {
+    while (b != 0) {
+        const U32 remainder = a % b;
+        a = b;
+        b = remainder;
+    }
+    return a;
+}
+
+//! Sort the clients (each array is indexed by client_trigger_isr port number)
+//! into trigger order, lay out the minor frames, and validate the result.
+//! Clients that share a trigger time run in port order. Every trigger time must
+//! fall before minimum_duration_micros, so that each client runs in every RTI
+//! it is scheduled for no matter how the duration is updated. Within each
+//! minor frame, distinct trigger times must be at least minimum_spacing_micros
+//! apart, so that the proxy ISR can keep up. The least common multiple of the
+//! periods must not exceed MET_MAX_MINOR_FRAMES. A period of 0 marks an unused
+//! client, which never triggers, so a partially filled period array leaves the
+//! remaining clients unused.
+//! Note: These checks are FW_ASSERTs, which fail compilation when evaluated
+//!       in a constant expression
+constexpr MetronomeSchedule buildMetronomeSchedule(const U32 (&client_trigger_times_micros)[MAX_CLIENTS],
+                                                   const U32 (&client_period_rtis)[MAX_CLIENTS],
+                                                   const U32 (&client_phase_rtis)[MAX_CLIENTS],
+                                                   const U32 minimum_duration_micros,
+                                                   const U32 minimum_spacing_micros = 0) {
+    MetronomeSchedule schedule{};
+
+    // Insertion sort, which is stable and simple enough for constexpr.
+    U32 major_frame_rtis = 1;
+    for (FwIndexType client = 0; client < MAX_CLIENTS; client++) {
+        const U32 time = client_trigger_times_micros[client];
+        const U32 period = client_period_rtis[client];
+        const U32 phase = client_phase_rtis[client];
+        FW_ASSERT(time < minimum_duration_micros, client, time, minimum_duration_micros);
+        FW_ASSERT(period <= MET_MAX_MINOR_FRAMES, client, period);
+        if (period == 0) {
+            FW_ASSERT(phase == 0, client, phase);
+        } else {
+            FW_ASSERT(phase < period, client, phase, period);
+            major_frame_rtis = (major_frame_rtis / metronomeScheduleGcd(major_frame_rtis, period)) * period;
+            FW_ASSERT(major_frame_rtis <= MET_MAX_MINOR_FRAMES, client, major_frame_rtis);
+        }
+
+        FwIndexType index = client;
+        while (index > 0 && schedule.trigger_time_micros[index - 1] > time) {
+            schedule.trigger_time_micros[index] = schedule.trigger_time_micros[index - 1];
+            schedule.port_num[index] = schedule.port_num[index - 1];
+            schedule.period_rtis[index] = schedule.period_rtis[index - 1];
+            schedule.phase_rtis[index] = schedule.phase_rtis[index - 1];
+            index--;
+        }
+        schedule.trigger_time_micros[index] = time;
+        schedule.port_num[index] = client;
+        schedule.period_rtis[index] = period;
+        schedule.phase_rtis[index] = phase;
+    }
+    schedule.major_frame_rtis = major_frame_rtis;
+
+    for (U32 frame = 0; frame < major_frame_rtis; frame++) {
+        U32 clients = 0;
+        FwIndexType previous = -1;
+        for (FwIndexType index = 0; index < MAX_CLIENTS; index++) {
+            if (schedule.period_rtis[index] == 0 ||
+                frame % schedule.period_rtis[index] != schedule.phase_rtis[index]) {
+                continue;
+            }
+            if (previous >= 0) {
+                const U32 gap = schedule.trigger_time_micros[index] - schedule.trigger_time_micros[previous];
+                FW_ASSERT(gap == 0 || gap >= minimum_spacing_micros, schedule.port_num[previous],
+                          schedule.port_num[index], gap);
+            }
+            clients |= (1U << index);
+            previous = index;
+        }
+        schedule.minor_frame_clients[frame] = clients;
+    }
+
+    return schedule;
+}
+
+//! Build a schedule where every client triggers in every RTI
+constexpr MetronomeSchedule buildMetronomeSchedule(const U32 (&client_trigger_times_micros)[MAX_CLIENTS],
+                                                   const U32 minimum_duration_micros,
+                                                   const U32 minimum_spacing_micros = 0) {
+    U32 periods[MAX_CLIENTS] = {};
+    U32 phases[MAX_CLIENTS] = {};
+    for (FwIndexType client = 0; client < MAX_CLIENTS; client++) {
+        periods[client] = 1;
+    }
+    return buildMetronomeSchedule(client_trigger_times_micros, periods, phases, minimum_duration_micros,
+                                  minimum_spacing_micros);
+}
+
+}  // namespace Va416x0Svc
+
+#endif
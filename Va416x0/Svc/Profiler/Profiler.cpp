@@ -21,15 +21,25 @@
 
 #include "Profiler.hpp"
 #include "Fw/Types/Assert.hpp"
+#include "Va416x0/Mmio/ClkTree/ClkTree.hpp"
 #include "Va416x0/Mmio/Cpu/Cpu.hpp"
+#include "Va416x0/Mmio/Dwt/Dwt.hpp"
 #include "Va416x0/Mmio/Lock/Lock.hpp"
-#include "Va416x0/Mmio/SysTick/SysTick.hpp"
+#include "Va416x0/Mmio/SysConfig/SysConfig.hpp"
+#include "Va416x0/Mmio/Timer/Timer.hpp"
 #include "config-vorago/ProfilerCfg.hpp"
 
 namespace Va416x0Svc {
 
+static_assert(sizeof(Profiler::Header) % sizeof(Profiler::Event) == 0,
+              "events following the header must stay aligned to the event size");
+
+static inline Profiler::Header* HEADER_ADDRESS() {
+    return reinterpret_cast<Profiler::Header*>(PROFILER_MEMORY_REGION_START);
+}
+
 static inline Profiler::Event* START_ADDRESS() {
-    return reinterpret_cast<Profiler::Event*>(PROFILER_MEMORY_REGION_START);
+    return reinterpret_cast<Profiler::Event*>(PROFILER_MEMORY_REGION_START + (sizeof(Profiler::Header) / sizeof(U32)));
 }
 
 static inline Profiler::Event* END_ADDRESS() {
@@ -37,26 +47,92 @@ static inline Profiler::Event* END_ADDRESS() {
                                               (PROFILER_MEMORY_REGION_SIZE / sizeof(U32)));
 }
 
+static inline Profiler::Sample* SAMPLE_START_ADDRESS() {
+    return reinterpret_cast<Profiler::Sample*>(START_ADDRESS());
+}
+
+//! Samples don't necessarily divide the region evenly, so this may be short of END_ADDRESS
+static inline Profiler::Sample* SAMPLE_END_ADDRESS() {
+    return SAMPLE_START_ADDRESS() +
+           ((PROFILER_MEMORY_REGION_SIZE - sizeof(Profiler::Header)) / sizeof(Profiler::Sample));
+}
+
+static inline U16* COMPACT_START_ADDRESS() {
+    return reinterpret_cast<U16*>(START_ADDRESS());
+}
+
+//! Compact records are only written while the write pointer is at or before this address, so that the longest
+//! sequence of records always fits
+static inline U16* COMPACT_LIMIT_ADDRESS() {
+    return reinterpret_cast<U16*>(END_ADDRESS()) - Profiler::COMPACT_MAX_HALFWORDS;
+}
+
+static_assert((PROFILER_FUNCTION_TABLE_SIZE & (PROFILER_FUNCTION_TABLE_SIZE - 1)) == 0,
+              "function table size must be 0 or a power of two");
+static_assert(PROFILER_FUNCTION_TABLE_SIZE <= 0x4000, "function indices must not collide with the compact escapes");
+
 constexpr U32 RTI_DISABLED = 0xFF;
 constexpr U32 THUMB_MASK = 0x7FFFFFFE;
 constexpr U32 PHASE_FUNC_EXIT = 1 << 31;
+constexpr U32 EXCEPTION_SHIFT = 24;
+constexpr U32 TICKS_MASK = (1 << EXCEPTION_SHIFT) - 1;
+//! Largest delta that fits in a compact function exit record
+constexpr U32 COMPACT_EXIT_MAX_DELTA = 0x7FFF;
+//! Largest delta that fits in a compact function entry record
+constexpr U32 COMPACT_ENTER_MAX_DELTA = 0xFFFF;
+//! Number of function table entries to try before giving up and writing a raw record
+constexpr U32 FUNCTION_TABLE_MAX_PROBES = 8;
+
+constexpr U32 NO_SAMPLE_TIMER = 0xFFFFFFFF;
+constexpr U32 MICROSECONDS_PER_SECOND = 1000 * 1000;
+constexpr U32 SAMPLE_RTI_SHIFT = 20;
+constexpr U32 SAMPLE_OFFSET_MASK = (1 << SAMPLE_RTI_SHIFT) - 1;
+
+// Same exception stack frame layout as read by ExceptionHandler: R0, R1, R2, R3, R12, LR,
+// ReturnAddress (PC), XPSR
+constexpr U32 EXCEPTION_FRAME_LR_INDEX = 5;
+constexpr U32 EXCEPTION_FRAME_PC_INDEX = 6;
 
 __attribute__((no_instrument_function)) Profiler::Profiler(const char* const compName)
-    : ProfilerComponentBase(compName), m_rtisPerSecond(0), m_rti(RTI_DISABLED) {
-    FW_ASSERT(START_ADDRESS() != nullptr);
+    : ProfilerComponentBase(compName),
+      m_lastTicks(0),
+      m_compact(false),
+      m_sampling(false),
+      m_sampleTimerIndex(NO_SAMPLE_TIMER),
+      m_ringMode(false),
+      m_recording(false),
+      m_wrapCount(0),
+      m_rtisPerSecond(0),
+      m_rti(RTI_DISABLED),
+      m_mode(ProfilerMode::LINEAR),
+      m_rtiCount(0),
+      m_rtisRemaining(0),
+      m_triggerArmed(false),
+      m_trigger(ProfilerTrigger::SLACK_BELOW),
+      m_triggerThreshold(0),
+      m_triggerMode(ProfilerMode::LINEAR),
+      m_triggerRtiCount(0),
+      m_triggerFunction(0),
+      m_functionEntered(0) {
+    FW_ASSERT(PROFILER_MEMORY_REGION_START != nullptr);
     // Assert that the memory region starting address is U32-aligned
     U32 startAddress = reinterpret_cast<U32>(START_ADDRESS());
     FW_ASSERT((startAddress % sizeof(U32)) == 0, startAddress);
     // Assert that the memory region size is a multiple of the Event size
     FW_ASSERT((PROFILER_MEMORY_REGION_SIZE % sizeof(Event)) == 0, PROFILER_MEMORY_REGION_SIZE, sizeof(Event));
+    // Assert that there is room for the header and at least one event
+    FW_ASSERT(PROFILER_MEMORY_REGION_SIZE > sizeof(Header), PROFILER_MEMORY_REGION_SIZE, sizeof(Header));
 
     // Profiler is initially disabled, set the index to the end
     this->m_writePtr = END_ADDRESS();
+    this->m_compactPtr = reinterpret_cast<U16*>(END_ADDRESS());
+    this->m_samplePtr = SAMPLE_END_ADDRESS();
     // Initialize the memory region
     // Function address 0 indicates an unused buffer entry
     for (Event* writePtr = START_ADDRESS(); writePtr < END_ADDRESS(); writePtr++) {
         writePtr->functionAddress = 0;
     }
+    *HEADER_ADDRESS() = Header{HEADER_MAGIC, FORMAT_EVENT, 0, 0};
 }
 
 __attribute__((no_instrument_function)) void Profiler::configure(U32 rtis_per_second) {
@@ -64,67 +140,304 @@ __attribute__((no_instrument_function)) void Profiler::configure(U32 rtis_per_se
     this->m_rtisPerSecond = rtis_per_second;
 }
 
-__attribute__((no_instrument_function)) void Profiler::enable(U32 irq_freq, U32 clock_freq) {
+__attribute__((no_instrument_function)) void Profiler::configureSampling(U8 timer_peripheral_index,
+                                                                         U32 sample_period_micros,
+                                                                         U8 timer_interrupt_priority) {
+    Va416x0Mmio::Timer timer(timer_peripheral_index);
+
+    Va416x0Mmio::SysConfig::set_clk_enabled(timer, true);
+    Va416x0Mmio::SysConfig::reset_peripheral(timer);
+
+    U32 timer_freq = Va416x0Mmio::ClkTree::getActiveTimerFreq(timer);
+    U64 rstValueScaled = U64(timer_freq) * sample_period_micros;
+    FW_ASSERT((rstValueScaled % MICROSECONDS_PER_SECOND) == 0, timer_freq, sample_period_micros, rstValueScaled,
+              MICROSECONDS_PER_SECOND);
+    U32 rst_value = rstValueScaled / MICROSECONDS_PER_SECOND;
+    FW_ASSERT(rst_value > 0, rst_value);
+
+    // The timer stays disabled until sampling is enabled
+    timer.write_ctrl(Va416x0Mmio::Timer::CTRL_DISABLE);
+    timer.write_rst_value(rst_value);
+    timer.write_cnt_value(rst_value);
+    timer.write_csd_ctrl(0);
+
+    this->m_sampleTimerIndex = timer_peripheral_index;
+    this->m_sampleIc = Va416x0Mmio::Nvic::InterruptControl(timer.get_timer_done_exception());
+    this->m_sampleIc.set_interrupt_priority(timer_interrupt_priority);
+    this->m_sampleIc.set_interrupt_enabled(false);
+    this->m_sampleIc.set_interrupt_pending(false);
+}
+
+__attribute__((no_instrument_function)) void Profiler::enable(ProfilerMode mode) {
     // Disable interrupts for the duration of this function to ensure atomicity
     Va416x0Mmio::Lock::CriticalSectionLock lock;
 
-    // Configure and enable the SysTick counter
-    Va416x0Mmio::SysTick::configure(irq_freq, clock_freq);
-    Va416x0Mmio::SysTick::enable_counter();
-    // Then move the index pointer to the start of the memory region
-    this->m_writePtr = START_ADDRESS();
+    // Timestamps come from the DWT cycle counter, which is started by _start
+    FW_ASSERT(Va416x0Mmio::Dwt::is_cycle_counter_enabled());
+    this->m_ringMode = (mode == ProfilerMode::RING);
+    this->m_compact = (mode == ProfilerMode::COMPACT);
+    this->m_sampling = (mode == ProfilerMode::SAMPLING);
+    this->m_wrapCount.store(0, std::memory_order_relaxed);
+    this->m_recording = true;
+    // Mark the header as out of date until recording stops, in case the region is dumped before then
+    const U32 format = this->m_compact ? FORMAT_COMPACT : (this->m_sampling ? FORMAT_SAMPLE : FORMAT_EVENT);
+    *HEADER_ADDRESS() = Header{HEADER_MAGIC, format, (this->m_ringMode ? FLAG_RING : 0) | FLAG_RECORDING, 0};
+
+    if (this->m_compact) {
+        // Function indices are defined within the capture, so start over with an empty table
+        for (U32& address : this->m_functionTable) {
+            address = 0;
+        }
+        // The first record carries a delta from when recording started
+        this->m_lastTicks = Va416x0Mmio::Dwt::now_cycles();
+        this->m_compactPtr = COMPACT_START_ADDRESS();
+    } else if (this->m_sampling) {
+        FW_ASSERT(this->m_sampleTimerIndex != NO_SAMPLE_TIMER);
+        this->m_samplePtr = SAMPLE_START_ADDRESS();
+
+        Va416x0Mmio::Timer timer(static_cast<U8>(this->m_sampleTimerIndex));
+        timer.write_cnt_value(timer.read_rst_value());
+        timer.write_ctrl(Va416x0Mmio::Timer::CTRL_ENABLE | Va416x0Mmio::Timer::CTRL_IRQ_ENB |
+                         Va416x0Mmio::Timer::CTRL_STATUS_PULSE);
+        this->m_sampleIc.set_interrupt_pending(false);
+        this->m_sampleIc.set_interrupt_enabled(true);
+    } else {
+        // Then move the index pointer to the start of the memory region
+        this->m_writePtr = START_ADDRESS();
+    }
 }
 
 __attribute__((no_instrument_function)) void Profiler::disable() {
     // Disable interrupts for the duration of this function to ensure atomicity
     Va416x0Mmio::Lock::CriticalSectionLock lock;
 
-    // Mark the current location with all 0xFF's so the parser knows where to terminate
-    // First check that there is room for an Event to be written, if the profiler memory region has
-    // already been filled (or if the profiler was never enabled), the write pointer will be
-    // pointing to the end of the memory region so it cannot be safely written to
-    if (this->m_writePtr < END_ADDRESS()) {
-        this->m_writePtr->functionAddress = 0xFFFFFFFF;
-        this->m_writePtr->ticks = 0xFFFFFFFF;
-    }
-    // Then move the index pointer to the end of the memory region
-    this->m_writePtr = END_ADDRESS();
+    this->stop();
     this->m_rti = RTI_DISABLED;
+    this->m_rtisRemaining = 0;
+    this->m_triggerArmed = false;
+    this->m_triggerFunction = 0;
 }
 
-__attribute__((no_instrument_function)) void Profiler::funcEnter(void* function) {
-    // Disable interrupts in the body of the profiler hook; profile events triggering during ISRs
-    // cause race conditions which lead to events being dropped
+__attribute__((no_instrument_function)) void Profiler::freeze() {
+    // Disable interrupts for the duration of this function to ensure atomicity
     Va416x0Mmio::Lock::CriticalSectionLock lock;
 
-    this->trace(reinterpret_cast<U32>(function));
+    this->stop();
 }
 
-__attribute__((no_instrument_function)) void Profiler::funcExit(void* function) {
-    // Disable interrupts in the body of the profiler hook; profile events triggering during ISRs
-    // cause race conditions which lead to events being dropped
-    Va416x0Mmio::Lock::CriticalSectionLock lock;
+__attribute__((no_instrument_function)) void Profiler::stop() {
+    if (!this->m_recording) {
+        return;
+    }
+
+    // The header replaces an end marker in the event stream, so that the parser can find both the end of a linear
+    // capture and the oldest event of a ring that has wrapped
+    U32 flags = 0;
+    if (this->m_ringMode) {
+        flags |= FLAG_RING;
+        if (this->m_wrapCount.load(std::memory_order_relaxed) > 0) {
+            flags |= FLAG_WRAPPED;
+        }
+    }
+    if (this->m_compact) {
+        const U32 writeIndex = static_cast<U32>(this->m_compactPtr - COMPACT_START_ADDRESS());
+        *HEADER_ADDRESS() = Header{HEADER_MAGIC, FORMAT_COMPACT, flags, writeIndex};
+    } else if (this->m_sampling) {
+        this->m_sampleIc.set_interrupt_enabled(false);
+        Va416x0Mmio::Timer(static_cast<U8>(this->m_sampleTimerIndex)).write_ctrl(Va416x0Mmio::Timer::CTRL_DISABLE);
+        this->m_sampleIc.set_interrupt_pending(false);
 
-    this->trace(reinterpret_cast<U32>(function) | PHASE_FUNC_EXIT);
+        const U32 writeIndex = static_cast<U32>(this->m_samplePtr - SAMPLE_START_ADDRESS());
+        *HEADER_ADDRESS() = Header{HEADER_MAGIC, FORMAT_SAMPLE, flags, writeIndex};
+    } else {
+        const U32 writeIndex = static_cast<U32>(this->m_writePtr.load(std::memory_order_relaxed) - START_ADDRESS());
+        *HEADER_ADDRESS() = Header{HEADER_MAGIC, FORMAT_EVENT, flags, writeIndex};
+    }
+
+    // Then move the index pointers to the end of the memory region
+    this->m_writePtr = END_ADDRESS();
+    this->m_compactPtr = reinterpret_cast<U16*>(END_ADDRESS());
+    this->m_samplePtr = SAMPLE_END_ADDRESS();
+    this->m_recording = false;
+}
+
+__attribute__((no_instrument_function)) void Profiler::funcEnter(void* function) {
+    if ((reinterpret_cast<U32>(function) & THUMB_MASK) == this->m_triggerFunction) {
+        this->m_functionEntered.store(1, std::memory_order_relaxed);
+    }
+    if (this->m_compact) {
+        // Compact records are variable length and share the previous timestamp, so they are still
+        // written with interrupts disabled
+        Va416x0Mmio::Lock::CriticalSectionLock lock;
+        this->traceCompact(reinterpret_cast<U32>(function));
+    } else {
+        this->trace(reinterpret_cast<U32>(function));
+    }
+}
+
+__attribute__((no_instrument_function)) void Profiler::funcExit(void* function) {
+    if (this->m_compact) {
+        // Compact records are variable length and share the previous timestamp, so they are still
+        // written with interrupts disabled
+        Va416x0Mmio::Lock::CriticalSectionLock lock;
+        this->traceCompact(reinterpret_cast<U32>(function) | PHASE_FUNC_EXIT);
+    } else {
+        this->trace(reinterpret_cast<U32>(function) | PHASE_FUNC_EXIT);
+    }
 }
 
 __attribute__((no_instrument_function)) void Profiler::trace(U32 functionAndPhase) {
-    if (this->m_writePtr < END_ADDRESS()) {
-        U32 ticks = Va416x0Mmio::SysTick::read_cvr();
+    // Reserve an event without masking interrupts. If an ISR records events between the load and
+    // the compare-and-swap (LDREX/STREX), the swap fails and we retry with the updated pointer.
+    Event* slot = this->m_writePtr.load(std::memory_order_relaxed);
+    Event* next;
+    do {
+        if (slot >= END_ADDRESS()) {
+            return;
+        }
+        next = slot + 1;
+        // In ring mode, overwrite the oldest events instead of stopping
+        if (next == END_ADDRESS() && this->m_ringMode) {
+            next = START_ADDRESS();
+        }
+    } while (!this->m_writePtr.compare_exchange_weak(slot, next, std::memory_order_relaxed));
+
+    if (next == START_ADDRESS()) {
+        this->m_wrapCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // An ISR may record events between the reservation and the writes below, so events from
+    // different exceptions can be out of order in the buffer. Tagging each event with the active
+    // exception lets the parser separate them into streams that are each in order.
+    const U32 ticks = Va416x0Mmio::Dwt::now_cycles();
+    const U32 exception = Va416x0Mmio::Cpu::get_active_exception();
+    slot->functionAddress = functionAndPhase;
+    slot->exceptionAndTicks = (exception << EXCEPTION_SHIFT) | (ticks & TICKS_MASK);
+}
+
+__attribute__((no_instrument_function)) void Profiler::traceCompact(U32 functionAndPhase) {
+    U16* writePtr = this->m_compactPtr;
+    if (writePtr > COMPACT_LIMIT_ADDRESS()) {
+        return;
+    }
+
+    const U32 ticks = Va416x0Mmio::Dwt::now_cycles();
+    U32 delta = ticks - this->m_lastTicks;
+    this->m_lastTicks = ticks;
 
-        auto index = this->m_writePtr;
-        index->functionAddress = functionAndPhase;
-        index->ticks = ticks;
+    // Only halfword stores are used, so that this is safe for the nostrb toolchains
+    const bool isExit = (functionAndPhase & PHASE_FUNC_EXIT) != 0;
+    if (delta > (isExit ? COMPACT_EXIT_MAX_DELTA : COMPACT_ENTER_MAX_DELTA)) {
+        writePtr[0] = COMPACT_TIMESTAMP;
+        writePtr[1] = static_cast<U16>(ticks);
+        writePtr[2] = static_cast<U16>(ticks >> 16);
+        writePtr += 3;
+        delta = 0;
+    }
 
-        this->m_writePtr = index + 1;
+    if (isExit) {
+        writePtr[0] = static_cast<U16>(COMPACT_EXIT | delta);
+        writePtr += 1;
+    } else {
+        const U16 index = this->lookupFunction(functionAndPhase, writePtr);
+        if (index == COMPACT_RAW) {
+            writePtr[0] = COMPACT_RAW;
+            writePtr[1] = static_cast<U16>(functionAndPhase);
+            writePtr[2] = static_cast<U16>(functionAndPhase >> 16);
+            writePtr[3] = static_cast<U16>(delta);
+            writePtr += 4;
+        } else {
+            writePtr[0] = index;
+            writePtr[1] = static_cast<U16>(delta);
+            writePtr += 2;
+        }
     }
+    this->m_compactPtr = writePtr;
+}
+
+__attribute__((no_instrument_function)) U16 Profiler::lookupFunction(U32 address, U16*& writePtr) {
+    if (PROFILER_FUNCTION_TABLE_SIZE == 0) {
+        return COMPACT_RAW;
+    }
+
+    // Fibonacci hashing spreads the (mostly small, even) code addresses across the table
+    U32 index = ((address * 2654435769U) >> 16) & (PROFILER_FUNCTION_TABLE_SIZE - 1);
+    for (U32 probe = 0; probe < FUNCTION_TABLE_MAX_PROBES; probe++) {
+        const U32 entry = this->m_functionTable[index];
+        if (entry == address) {
+            return static_cast<U16>(index);
+        }
+        if (entry == 0) {
+            this->m_functionTable[index] = address;
+            writePtr[0] = COMPACT_DEFINE;
+            writePtr[1] = static_cast<U16>(index);
+            writePtr[2] = static_cast<U16>(address);
+            writePtr[3] = static_cast<U16>(address >> 16);
+            writePtr += 4;
+            return static_cast<U16>(index);
+        }
+        index = (index + 1) & (PROFILER_FUNCTION_TABLE_SIZE - 1);
+    }
+    return COMPACT_RAW;
 }
 
 // ----------------------------------------------------------------------
 // Handler implementations for typed input ports
 // ----------------------------------------------------------------------
 
+__attribute__((no_instrument_function)) void Profiler::checkTrigger() {
+    bool fired = false;
+    U32 value = 0;
+    switch (this->m_trigger.e) {
+        case ProfilerTrigger::SLACK_BELOW: {
+            // Slack is only measured once the main loop has completed an RTI
+            const Va416x0::MlPerformanceCounts counts = this->getPerformanceCounts_out(0);
+            value = counts.get_slack().get_last();
+            fired = (counts.get_rti_count() > 0) && (value < this->m_triggerThreshold);
+            break;
+        }
+        case ProfilerTrigger::IRQ_DUTY_ABOVE:
+            value = this->getLastRtiIrqDuty_out(0);
+            fired = (value > this->m_triggerThreshold);
+            break;
+        case ProfilerTrigger::FUNCTION_ENTERED:
+            value = this->m_triggerFunction;
+            fired = (this->m_functionEntered.exchange(0, std::memory_order_relaxed) != 0);
+            break;
+        default:
+            FW_ASSERT(0, this->m_trigger.e);
+            break;
+    }
+    if (!fired) {
+        return;
+    }
+
+    this->m_triggerArmed = false;
+    this->m_triggerFunction = 0;
+    // A RING capture has been recording since the trigger was armed, so that it includes the lead-up.
+    // Otherwise recording starts now, partway through the RTI in which the trigger fired.
+    if (!this->m_recording) {
+        this->enable(this->m_triggerMode);
+    }
+    // Count the rest of this RTI as well as the requested ones, as for a capture started by ENABLE
+    this->m_rtisRemaining = (this->m_triggerRtiCount == 0) ? 0 : (this->m_triggerRtiCount + 1);
+    this->log_ACTIVITY_HI_TriggerFired(this->m_trigger, value);
+}
+
 __attribute__((no_instrument_function)) void Profiler::run_handler(FwIndexType portNum, U32 context) {
+    // Count down the capture window first, so that a capture started below gets all of its RTIs
+    if (this->m_rtisRemaining > 0) {
+        this->m_rtisRemaining--;
+        if (this->m_rtisRemaining == 0) {
+            this->freeze();
+            this->log_ACTIVITY_HI_CaptureComplete(HEADER_ADDRESS()->writeIndex);
+        }
+    }
+
+    if (this->m_triggerArmed) {
+        this->checkTrigger();
+    }
+
     // Exit unless the start RTI has been set via the ENABLE command
     if (this->m_rti == RTI_DISABLED) {
         return;
@@ -137,16 +450,60 @@ __attribute__((no_instrument_function)) void Profiler::run_handler(FwIndexType p
     // Assert that time is valid, as run should be invoked after Metronome starts
     FW_ASSERT(rti_time.get_isValid());
     if ((rti_time.get_rtiTime().get_rti() % this->m_rtisPerSecond) == trigger_rti) {
-        this->enable();
+        this->enable(this->m_mode);
         this->m_rti = RTI_DISABLED;
+        // Count the leading RTI as well as the requested ones
+        this->m_rtisRemaining = (this->m_rtiCount == 0) ? 0 : (this->m_rtiCount + 1);
     }
 }
 
+__attribute__((no_instrument_function)) void Profiler::sample_isr_handler(FwIndexType portNum) {
+    // Only this ISR writes samples, and stop() runs with interrupts disabled, so no reservation is needed
+    Sample* slot = this->m_samplePtr;
+    if (slot >= SAMPLE_END_ADDRESS()) {
+        return;
+    }
+
+    // The VectorTable records the stack pointer on entry to this interrupt, from the main or
+    // process stack as selected by EXC_RETURN, which is where the hardware stacked the frame
+    // of the interrupted context.
+    U32 pc = 0;
+    U32 lr = 0;
+    if (this->isConnected_getExceptionFrame_OutputPort(0)) {
+        const U32 frameAddress = this->getExceptionFrame_out(0);
+        if (frameAddress != 0) {
+            const U32* framePointer = reinterpret_cast<const U32*>(frameAddress);
+            pc = framePointer[EXCEPTION_FRAME_PC_INDEX];
+            lr = framePointer[EXCEPTION_FRAME_LR_INDEX];
+        }
+    }
+
+    U32 rtiAndOffset = 0;
+    Va416x0Types::RtiTimeWithValidity rti_time = {false, Va416x0Types::RtiTime{0, 0}};
+    if (this->isConnected_getRtiTime_OutputPort(0)) {
+        rti_time = this->getRtiTime_out(0);
+    }
+    if (rti_time.get_isValid()) {
+        const U32 offset = rti_time.get_rtiTime().get_offsetUs();
+        rtiAndOffset = (rti_time.get_rtiTime().get_rti() << SAMPLE_RTI_SHIFT) |
+                       (offset > SAMPLE_OFFSET_MASK ? SAMPLE_OFFSET_MASK : offset);
+    }
+
+    slot->pc = pc;
+    slot->lr = lr;
+    slot->rtiAndOffset = rtiAndOffset;
+    this->m_samplePtr = slot + 1;
+}
+
 // ----------------------------------------------------------------------
 // Handler implementations for commands
 // ----------------------------------------------------------------------
 
-__attribute__((no_instrument_function)) void Profiler::ENABLE_cmdHandler(FwOpcodeType opCode, U32 cmdSeq, U32 rti) {
+__attribute__((no_instrument_function)) void Profiler::ENABLE_cmdHandler(FwOpcodeType opCode,
+                                                                          U32 cmdSeq,
+                                                                          U32 rti,
+                                                                          Va416x0Svc::ProfilerMode mode,
+                                                                          U32 rti_count) {
     // Assert that the profiler has been configured
     FW_ASSERT(this->m_rtisPerSecond > 0);
 
@@ -156,18 +513,101 @@ __attribute__((no_instrument_function)) void Profiler::ENABLE_cmdHandler(FwOpcod
         this->cmdResponse_out(opCode, cmdSeq, Fw::CmdResponse::VALIDATION_ERROR);
         return;
     }
-    // Verify that the RTI is not already set
-    if (this->m_rti != RTI_DISABLED) {
+    // Verify that the RTI is not already set and that no trigger is armed
+    if (this->m_rti != RTI_DISABLED || this->m_triggerArmed) {
         this->log_WARNING_HI_ProfilerAlreadyActive(this->m_rti);
         this->cmdResponse_out(opCode, cmdSeq, Fw::CmdResponse::VALIDATION_ERROR);
         return;
     }
 
+    if (mode == ProfilerMode::SAMPLING && this->m_sampleTimerIndex == NO_SAMPLE_TIMER) {
+        this->log_WARNING_HI_SamplingNotConfigured();
+        this->cmdResponse_out(opCode, cmdSeq, Fw::CmdResponse::VALIDATION_ERROR);
+        return;
+    }
+
     // Set the RTI at which the rate group handler will enable the profiler
+    this->m_mode = mode;
+    this->m_rtiCount = rti_count;
     this->m_rti = rti;
     this->cmdResponse_out(opCode, cmdSeq, Fw::CmdResponse::OK);
 }
 
+__attribute__((no_instrument_function)) void Profiler::FREEZE_cmdHandler(FwOpcodeType opCode, U32 cmdSeq) {
+    bool wasRecording;
+    U32 writeIndex = 0;
+    U32 wrapCount = 0;
+    {
+        Va416x0Mmio::Lock::CriticalSectionLock lock;
+        wasRecording = this->m_recording;
+        // Freezing ends any capture window, and a trigger armed in RING mode with it
+        this->m_rtisRemaining = 0;
+        if (this->m_triggerArmed && this->m_triggerMode == ProfilerMode::RING) {
+            this->m_triggerArmed = false;
+            this->m_triggerFunction = 0;
+        }
+        if (wasRecording) {
+            wrapCount = this->m_wrapCount.load(std::memory_order_relaxed);
+            this->stop();
+            writeIndex = HEADER_ADDRESS()->writeIndex;
+        }
+    }
+
+    if (!wasRecording) {
+        this->log_WARNING_LO_ProfilerNotRecording();
+        this->cmdResponse_out(opCode, cmdSeq, Fw::CmdResponse::EXECUTION_ERROR);
+        return;
+    }
+
+    this->log_ACTIVITY_HI_ProfilerFrozen(writeIndex, wrapCount);
+    this->cmdResponse_out(opCode, cmdSeq, Fw::CmdResponse::OK);
+}
+
+__attribute__((no_instrument_function)) void Profiler::ARM_TRIGGER_cmdHandler(FwOpcodeType opCode,
+                                                                               U32 cmdSeq,
+                                                                               Va416x0Svc::ProfilerTrigger trigger,
+                                                                               U32 threshold,
+                                                                               Va416x0Svc::ProfilerMode mode,
+                                                                               U32 rti_count) {
+    // Assert that the profiler has been configured
+    FW_ASSERT(this->m_rtisPerSecond > 0);
+
+    // Verify that no capture is pending or in progress
+    if (this->m_rti != RTI_DISABLED || this->m_triggerArmed || this->m_recording) {
+        this->log_WARNING_HI_ProfilerAlreadyActive(this->m_rti);
+        this->cmdResponse_out(opCode, cmdSeq, Fw::CmdResponse::VALIDATION_ERROR);
+        return;
+    }
+
+    if ((trigger == ProfilerTrigger::SLACK_BELOW && !this->isConnected_getPerformanceCounts_OutputPort(0)) ||
+        (trigger == ProfilerTrigger::IRQ_DUTY_ABOVE && !this->isConnected_getLastRtiIrqDuty_OutputPort(0))) {
+        this->log_WARNING_HI_TriggerNotConnected(trigger);
+        this->cmdResponse_out(opCode, cmdSeq, Fw::CmdResponse::VALIDATION_ERROR);
+        return;
+    }
+
+    if (mode == ProfilerMode::SAMPLING && this->m_sampleTimerIndex == NO_SAMPLE_TIMER) {
+        this->log_WARNING_HI_SamplingNotConfigured();
+        this->cmdResponse_out(opCode, cmdSeq, Fw::CmdResponse::VALIDATION_ERROR);
+        return;
+    }
+
+    this->m_trigger = trigger;
+    this->m_triggerThreshold = threshold;
+    this->m_triggerMode = mode;
+    this->m_triggerRtiCount = rti_count;
+    this->m_functionEntered.store(0, std::memory_order_relaxed);
+    if (mode == ProfilerMode::RING) {
+        this->enable(mode);
+    }
+    // Set last, since the hooks may see it as soon as it is written
+    if (trigger == ProfilerTrigger::FUNCTION_ENTERED) {
+        this->m_triggerFunction = threshold & THUMB_MASK;
+    }
+    this->m_triggerArmed = true;
+    this->cmdResponse_out(opCode, cmdSeq, Fw::CmdResponse::OK);
+}
+
 }  // namespace Va416x0Svc
 
 extern "C" {
@@ -179,4 +619,9 @@ __attribute__((used, no_instrument_function)) void __cyg_profile_func_enter(void
 __attribute__((used, no_instrument_function)) void __cyg_profile_func_exit(void* function, void* call_site) {
     Va416x0Svc::profiler.funcExit(function);
 }
+
+//! Called by _exit so that a ring capture ends at the fault instead of being overwritten
+__attribute__((used, no_instrument_function)) void va416x0_profiler_freeze() {
+    Va416x0Svc::profiler.freeze();
+}
 }
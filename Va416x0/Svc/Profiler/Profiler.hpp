@@ -22,7 +22,11 @@
 #ifndef Scythe_Profiler_HPP
 #define Scythe_Profiler_HPP
 
+#include <atomic>
+
+#include "Va416x0/Mmio/Nvic/Nvic.hpp"
 #include "Va416x0/Svc/Profiler/ProfilerComponentAc.hpp"
+#include "config-vorago/ProfilerCfg.hpp"
 
 namespace Va416x0Svc {
 
@@ -33,9 +37,62 @@ class Profiler : public ProfilerComponentBase {
         // the most-significant bit of the function address is used to indicate the phase
         // set to 0 for entry, set to 1 for exit
         U32 functionAddress;
-        U32 ticks;
+        // bits 31:24 hold the exception number that was active when the event was recorded (0 in
+        // thread mode), and bits 23:0 hold the low 24 bits of the cycle counter
+        U32 exceptionAndTicks;
+    };
+
+    //! Represents the interrupted context at one tick of the sampling timer
+    struct Sample {
+        // return address stacked by the interrupt, or 0 if it could not be found
+        U32 pc;
+        // link register stacked by the interrupt, or 0 if it could not be found
+        U32 lr;
+        // bits 31:20 hold the low 12 bits of the RTI index, and bits 19:0 hold the offset into the
+        // RTI in microseconds
+        U32 rtiAndOffset;
     };
 
+    //! Describes the events in the memory region. It is stored at the start of
+    //! the region, and the events follow it.
+    struct Header {
+        //! Always HEADER_MAGIC
+        U32 magic;
+        //! Layout of the events; FORMAT_EVENT for Event, FORMAT_COMPACT, or FORMAT_SAMPLE for Sample
+        U32 format;
+        //! Combination of the FLAG_* values
+        U32 flags;
+        //! Index of the next event (or halfword, for FORMAT_COMPACT) that would
+        //! have been written. Once the ring has wrapped, this is also the index
+        //! of the oldest event.
+        U32 writeIndex;
+    };
+
+    static constexpr U32 HEADER_MAGIC = 0x464F5250;  // "PROF"
+    static constexpr U32 FORMAT_EVENT = 1;
+    //! Stream of U16 records; see the COMPACT_* values
+    static constexpr U32 FORMAT_COMPACT = 2;
+    static constexpr U32 FORMAT_SAMPLE = 3;
+    //! The events were recorded in RING mode
+    static constexpr U32 FLAG_RING = 1 << 0;
+    //! The ring has wrapped at least once, so every event slot is in use
+    static constexpr U32 FLAG_WRAPPED = 1 << 1;
+    //! The profiler was still recording, so writeIndex is out of date
+    static constexpr U32 FLAG_RECORDING = 1 << 2;
+
+    //! Compact records. Timestamps are deltas in cycles from the previous record.
+    //! Function exit: COMPACT_EXIT | delta (15 bits). The function is the one most recently entered.
+    static constexpr U16 COMPACT_EXIT = 0x8000;
+    //! Function entry: function index, delta (16 bits)
+    //! The previous record's timestamp is replaced: COMPACT_TIMESTAMP, cycles (low half), cycles (high half)
+    static constexpr U16 COMPACT_TIMESTAMP = 0x7FFF;
+    //! Defines the address of a function index: COMPACT_DEFINE, function index, address (low half), address (high half)
+    static constexpr U16 COMPACT_DEFINE = 0x7FFE;
+    //! Function entry without an index: COMPACT_RAW, address (low half), address (high half), delta (16 bits)
+    static constexpr U16 COMPACT_RAW = 0x7FFD;
+    //! Longest record sequence written by one hook: DEFINE, TIMESTAMP, and a function entry
+    static constexpr U32 COMPACT_MAX_HALFWORDS = 4 + 3 + 2;
+
     //! Construct Profiler object
     Profiler(const char* const compName  //!< Component name
     );
@@ -48,14 +105,21 @@ class Profiler : public ProfilerComponentBase {
     //! can enable trace captures on the appropriate RTI
     void configure(U32 rtis_per_second);
 
+    //! Set up a spare timer to interrupt every sample_period_micros while the profiler is in SAMPLING mode.
+    //! The timer's interrupt must be connected to sample_isr, and should have a higher priority than the
+    //! interrupts to be sampled.
+    void configureSampling(U8 timer_peripheral_index, U32 sample_period_micros, U8 timer_interrupt_priority);
+
     //! Enable profiler data collection
-    void enable(U32 irq_freq = 1,          //!< SysTick IRQ frequency
-                U32 clock_freq = 0xFFFFFF  //!< SysTick clock frequency
-    );
+    void enable(ProfilerMode mode);
 
     //! Disable profiler data collection
     void disable();
 
+    //! Stop profiler data collection and record where it stopped in the header. Does nothing if the profiler is
+    //! not recording, so that a capture that was already stopped is preserved. Safe to call from fatal handlers.
+    void freeze();
+
     //! Function entry hook
     void funcEnter(void* function);
 
@@ -70,6 +134,19 @@ class Profiler : public ProfilerComponentBase {
     //! Common code for funcEnter and funcExit used to store events to the memory region
     void trace(U32 functionAndPhase);
 
+    //! Equivalent of trace for COMPACT mode
+    void traceCompact(U32 functionAndPhase);
+
+    //! Find or assign the index of a function for COMPACT mode. Writes a COMPACT_DEFINE record when a new index is
+    //! assigned. Returns COMPACT_RAW if the function table has no room for it or is configured out.
+    U16 lookupFunction(U32 address, U16*& writePtr);
+
+    //! Fill in the header for the events recorded so far and stop recording
+    void stop();
+
+    //! Check the armed trigger and start the capture window if it fired
+    void checkTrigger();
+
     // ----------------------------------------------------------------------
     // Handler implementations for typed input ports
     // ----------------------------------------------------------------------
@@ -81,6 +158,12 @@ class Profiler : public ProfilerComponentBase {
                      U32 context           //!< The call order
                      ) override;
 
+    //! Handler implementation for sample_isr
+    //!
+    //! Interrupt from the sampling timer set up by configureSampling
+    void sample_isr_handler(FwIndexType portNum  //!< The port number
+                            ) override;
+
     // ----------------------------------------------------------------------
     // Handler implementations for commands
     // ----------------------------------------------------------------------
@@ -88,24 +171,91 @@ class Profiler : public ProfilerComponentBase {
     //! Handler implementation for command ENABLE
     //!
     //! Enable the profiler
-    void ENABLE_cmdHandler(FwOpcodeType opCode,  //!< The opcode
-                           U32 cmdSeq,           //!< The command sequence number
-                           U32 rti               //!< RTI on which to start the profile trace
+    void ENABLE_cmdHandler(FwOpcodeType opCode,           //!< The opcode
+                           U32 cmdSeq,                    //!< The command sequence number
+                           U32 rti,                       //!< RTI on which to start the profile trace
+                           Va416x0Svc::ProfilerMode mode,  //!< Whether to stop when the region is full
+                           U32 rti_count                   //!< Number of RTIs to capture, or 0 for no limit
                            ) override;
 
+    //! Handler implementation for command FREEZE
+    //!
+    //! Stop recording and preserve the events captured so far
+    void FREEZE_cmdHandler(FwOpcodeType opCode,  //!< The opcode
+                           U32 cmdSeq            //!< The command sequence number
+                           ) override;
+
+    //! Handler implementation for command ARM_TRIGGER
+    //!
+    //! Capture when a trigger condition is met
+    void ARM_TRIGGER_cmdHandler(FwOpcodeType opCode,                  //!< The opcode
+                                U32 cmdSeq,                           //!< The command sequence number
+                                Va416x0Svc::ProfilerTrigger trigger,  //!< Condition to wait for
+                                U32 threshold,  //!< Cycles, or the function address for FUNCTION_ENTERED
+                                Va416x0Svc::ProfilerMode mode,  //!< How to record
+                                U32 rti_count  //!< Number of RTIs to capture after the trigger, or 0 for no limit
+                                ) override;
+
   private:
     // ----------------------------------------------------------------------
     // Member variables
     // ----------------------------------------------------------------------
 
     //! Pointer to the current index in the profiler memory region; encapsulates enable/disable
-    //! functionality and is set to the end of the memory region when disabled
-    Event* m_writePtr;
+    //! functionality and is set to the end of the memory region when disabled. The hooks reserve
+    //! events by advancing it with a compare-and-swap, so that they don't need to mask interrupts.
+    std::atomic<Event*> m_writePtr;
+    //! Equivalent of m_writePtr for COMPACT mode; set past the last usable halfword when disabled
+    U16* m_compactPtr;
+    //! Timestamp of the previous COMPACT record
+    U32 m_lastTicks;
+    //! Whether the hooks write compact records instead of events
+    bool m_compact;
+    //! Whether the sampling timer records samples
+    bool m_sampling;
+    //! Equivalent of m_writePtr for SAMPLING mode; set to the end of the memory region when not sampling
+    Sample* m_samplePtr;
+    //! Timer used for SAMPLING mode, or NO_SAMPLE_TIMER if configureSampling was not called
+    U32 m_sampleTimerIndex;
+    //! Interrupt of the timer used for SAMPLING mode
+    Va416x0Mmio::Nvic::InterruptControl m_sampleIc;
+    //! Whether trace wraps around to the first event instead of stopping at the end of the region
+    bool m_ringMode;
+    //! Whether data collection was enabled and has not been stopped yet
+    bool m_recording;
+    //! Number of times the ring has wrapped since the profiler was enabled
+    std::atomic<U32> m_wrapCount;
 
     //! RTIs per second, as configured for the Metronome component
     U32 m_rtisPerSecond;
     //! RTI on which the profiler should be enabled; set by the ENABLE command
     U32 m_rti;
+    //! Mode to enable the profiler in; set by the ENABLE command
+    ProfilerMode m_mode;
+    //! Number of RTIs to capture once the profiler is enabled by the ENABLE command, or 0 for no limit
+    U32 m_rtiCount;
+    //! RTIs left before the current capture is frozen, or 0 if it has no limit
+    U32 m_rtisRemaining;
+
+    //! Whether a trigger has been armed by the ARM_TRIGGER command and has not fired yet
+    bool m_triggerArmed;
+    //! Armed trigger condition
+    ProfilerTrigger m_trigger;
+    //! Threshold of the armed trigger, in cycles
+    U32 m_triggerThreshold;
+    //! Mode to enable the profiler in when the trigger fires; RING mode is enabled when arming instead
+    ProfilerMode m_triggerMode;
+    //! Number of RTIs to capture after the trigger fires, or 0 for no limit
+    U32 m_triggerRtiCount;
+    //! Address of the FUNCTION_ENTERED trigger without its Thumb bit, or 0 if not armed. The hooks only
+    //! compare against it and set m_functionEntered; the trigger itself is processed by run_handler.
+    U32 m_triggerFunction;
+    //! Set by the hooks when the function of the FUNCTION_ENTERED trigger is entered
+    std::atomic<U32> m_functionEntered;
+
+    //! Function addresses for COMPACT mode, with 0 for unused entries. The index of a function is its position.
+    //! A single unused entry remains when PROFILER_FUNCTION_TABLE_SIZE is 0, since arrays can't be empty.
+    U32 m_functionTable[PROFILER_FUNCTION_TABLE_SIZE > 0 ? PROFILER_FUNCTION_TABLE_SIZE : 1];
 };
 
 //! Global singleton profiler instance
@@ -0,0 +1,95 @@
+// Copyright 2026 California Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// ======================================================================
+// \title  QueueMonitor.cpp
+// \brief  cpp file for QueueMonitor component implementation class
+// ======================================================================
+
+#include "Va416x0/Svc/QueueMonitor/QueueMonitor.hpp"
+
+#include "Va416x0/Os/IsrSafeQueue/IsrSafeQueue.hpp"
+
+namespace Va416x0Svc {
+
+using Va416x0Os::IsrSafeQueue::IsrSafeQueue;
+using Va416x0Os::IsrSafeQueue::IsrSafeQueueHandle;
+
+// ----------------------------------------------------------------------
+// Component construction and destruction
+// ----------------------------------------------------------------------
+
+QueueMonitor ::QueueMonitor(const char* const compName) : QueueMonitorComponentBase(compName) {}
+
+// ----------------------------------------------------------------------
+// Handler implementations for typed input ports
+// ----------------------------------------------------------------------
+
+void QueueMonitor ::Run_handler(FwIndexType portNum, U32 context) {
+    QmQueueCounts depth;
+    QmQueueCounts hwm;
+    QmQueueCounts drops;
+    QmQueueCycles latencyMax;
+    QmQueueCycles latencyMean;
+
+    // Queues are registered in creation order, so each queue keeps its slot
+    // from one sweep to the next.
+    FwIndexType slot = 0;
+    for (IsrSafeQueueHandle* queue = IsrSafeQueue::getNextQueue(nullptr); queue != nullptr;
+         queue = IsrSafeQueue::getNextQueue(queue)) {
+        // The queue name is only copied into an event argument when an event is emitted
+        if (slot >= QM_MAX_QUEUES) {
+            if (!this->m_slotsExhausted) {
+                this->log_WARNING_LO_QueueSlotsExhausted(Fw::LogStringArg(queue->m_name));
+                this->m_slotsExhausted = true;
+            }
+            break;
+        }
+
+        IsrSafeQueue::QueueStats stats;
+        IsrSafeQueue::getQueueStats(*queue, stats);
+        if (slot >= this->m_numSlots) {
+            this->log_ACTIVITY_LO_QueueSlotAssigned(static_cast<U32>(slot), Fw::LogStringArg(queue->m_name),
+                                                    static_cast<U32>(stats.depth));
+            this->m_numSlots = slot + 1;
+        }
+        if (stats.drops != this->m_lastDrops[slot]) {
+            this->log_WARNING_LO_QueueDropped(static_cast<U32>(slot), Fw::LogStringArg(queue->m_name),
+                                              stats.drops - this->m_lastDrops[slot]);
+            this->m_lastDrops[slot] = stats.drops;
+        }
+
+        depth[slot] = static_cast<U32>(stats.messages);
+        hwm[slot] = static_cast<U32>(stats.highMark);
+        drops[slot] = stats.drops;
+        latencyMax[slot] = stats.maxLatencyCycles;
+        latencyMean[slot] = stats.meanLatencyCycles;
+        slot++;
+    }
+
+    this->tlmWrite_QueueDepth(depth);
+    this->tlmWrite_QueueHwm(hwm);
+    this->tlmWrite_QueueDrops(drops);
+    this->tlmWrite_QueueLatencyMax(latencyMax);
+    this->tlmWrite_QueueLatencyMean(latencyMean);
+}
+
+Va416x0::QueueActivity QueueMonitor ::getQueueActivity_handler(FwIndexType portNum) {
+    return Va416x0::QueueActivity(static_cast<U32>(IsrSafeQueue::getTotalMessagesAvailable()),
+                                  IsrSafeQueue::getTotalMessagesSent(), IsrSafeQueue::getTotalMessagesReceived());
+}
+
+}  // namespace Va416x0Svc
@@ -0,0 +1,59 @@
+// Copyright 2026 California Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// ======================================================================
+// \title  QueueMonitor.hpp
+// \brief  hpp file for QueueMonitor component implementation class
+// ======================================================================
+
+#ifndef Va416x0_QueueMonitor_HPP
+#define Va416x0_QueueMonitor_HPP
+
+#include "Va416x0/Svc/QueueMonitor/QueueMonitorComponentAc.hpp"
+
+namespace Va416x0Svc {
+
+class QueueMonitor : public QueueMonitorComponentBase {
+  public:
+    // ----------------------------------------------------------------------
+    // Component construction and destruction
+    // ----------------------------------------------------------------------
+
+    //! Construct QueueMonitor object
+    QueueMonitor(const char* const compName);
+
+  private:
+    // ----------------------------------------------------------------------
+    // Handler implementations for typed input ports
+    // ----------------------------------------------------------------------
+
+    //! Handler implementation for Run
+    void Run_handler(FwIndexType portNum, U32 context) override;
+
+    //! Handler implementation for getQueueActivity
+    Va416x0::QueueActivity getQueueActivity_handler(FwIndexType portNum) override;
+
+    //! Number of queue slots reported by QueueSlotAssigned so far
+    FwIndexType m_numSlots = 0;
+    //! Whether QueueSlotsExhausted has been reported
+    bool m_slotsExhausted = false;
+    //! Drop count of each queue slot at the previous sweep
+    U32 m_lastDrops[QM_MAX_QUEUES] = {};
+};
+
+}  // namespace Va416x0Svc
+
+#endif
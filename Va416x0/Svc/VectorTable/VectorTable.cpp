@@ -23,9 +23,9 @@
 #include <Va416x0/Mmio/Cpu/Cpu.hpp>
 #include "Va416x0/Mmio/Amba/Amba.hpp"
 #include "Va416x0/Mmio/ClkTree/ClkTree.hpp"
+#include "Va416x0/Mmio/Dwt/Dwt.hpp"
 #include "Va416x0/Mmio/Nvic/Nvic.hpp"
 #include "Va416x0/Mmio/SysControl/SysControl.hpp"
-#include "Va416x0/Mmio/SysTick/SysTick.hpp"
 #include "Va416x0/Types/ExceptionNumberEnumAc.hpp"
 #include "Va416x0/Types/FppConstantsAc.hpp"
 
@@ -35,8 +35,39 @@
 #include <sys/unistd.h>
 #include <cstring>
 
+extern "C" {
+// Generated by VectorTableIsr.py
+extern void* const arm_vector_table[];
+
+void arm_isr_untimed(void);
+void arm_isr_untimed_body(const U32* frame);
+void arm_isr_unconnected(void);
+}
+
 namespace Va416x0Svc {
 
+// VTOR requires the table to be aligned to its size, rounded up to a power of two.
+constexpr U32 VECTOR_TABLE_ALIGNMENT = 1024;
+static_assert(Va416x0Types::NUMBER_OF_EXCEPTIONS * sizeof(void*) <= VECTOR_TABLE_ALIGNMENT,
+              "Vector table does not fit in its alignment");
+
+alignas(VECTOR_TABLE_ALIGNMENT) static void* ram_vector_table[Va416x0Types::NUMBER_OF_EXCEPTIONS];
+
+constexpr U8 NO_SLOT = 0xFF;
+constexpr U8 NO_LEVEL = 0xFF;
+
+// Number of RAM vector table entries checked against their expected value by each Run call.
+constexpr U32 SCRUB_ENTRIES_PER_RUN = 32;
+
+// NMI and HardFault have fixed priorities above every configurable one.
+constexpr U32 FIXED_PRIORITY_LEVEL = VT_PRIORITY_LEVELS - 1;
+// Only the top 3 bits of each priority are implemented, one level per group.
+constexpr U32 PRIORITY_LEVEL_SHIFT = 5;
+static_assert((Va416x0Mmio::Nvic::PRIORITY_MASK >> PRIORITY_LEVEL_SHIFT) == FIXED_PRIORITY_LEVEL - 1,
+              "Every configurable priority group needs its own level");
+static_assert(VT_TRACKED_EXCEPTIONS <= 32, "REPORT_TOP_IRQS tracks reported slots in a U32 bitmask");
+static_assert(VT_DURATION_BINS % VT_HISTOGRAM_SEGMENT_BINS == 0, "The histogram is reported in whole segments");
+
 // ----------------------------------------------------------------------
 // Component construction and destruction
 // ----------------------------------------------------------------------
@@ -45,7 +76,26 @@ VectorTable ::VectorTable(const char* const compName)
     : VectorTableComponentBase(compName),
       m_firstRtiCompleted(false),
       m_rtiCurrentDutyUtilTicks(0),
-      m_rtiHwmIrqDutyUtilTicks(0) {}
+      m_rtiLastDutyUtilTicks(0),
+      m_rtiHwmIrqDutyUtilTicks(0),
+      m_nestingDepth(0),
+      m_exceptionFrame(nullptr),
+      m_completedTicks(),
+      m_slotExceptions(),
+      m_exceptionStats(),
+      m_assignedSlots(0),
+      m_untrackedCount(0),
+      m_priorityTicks(),
+      m_untimedExceptions(),
+      m_vectorTableInstalled(false),
+      m_scrubCursor(0) {
+    for (U8& slot : this->m_exceptionSlots) {
+        slot = NO_SLOT;
+    }
+    for (U8& level : this->m_priorityLevels) {
+        level = NO_LEVEL;
+    }
+}
 
 VectorTable ::~VectorTable() {}
 
@@ -79,43 +129,248 @@ void VectorTable::REPORT_RTI_STATS_cmdHandler(FwOpcodeType opCode, U32 cmdSeq) {
     this->cmdResponse_out(opCode, cmdSeq, Fw::CmdResponse::OK);
 }
 
-void VectorTable::handle_exception(U8 exception) {
+void VectorTable::REPORT_TOP_IRQS_cmdHandler(FwOpcodeType opCode, U32 cmdSeq, U32 count) {
+    U32 tracked = this->m_assignedSlots.load();
+    if (tracked > VT_TRACKED_EXCEPTIONS) {
+        tracked = VT_TRACKED_EXCEPTIONS;
+    }
+
+    // Report the slots in order of total ticks by picking the largest unreported one each time.
+    // Slots are only ever added, so a slot assigned during the report is simply left out.
+    U32 reported = 0;
+    for (U32 i = 0; i < count && i < tracked; i++) {
+        U32 best = VT_TRACKED_EXCEPTIONS;
+        ExceptionStats bestStats;
+        for (U32 slot = 0; slot < tracked; slot++) {
+            if ((reported & (1U << slot)) != 0) {
+                continue;
+            }
+            // Copy the statistics with interrupts disabled, since the ISRs update them in place
+            Va416x0Mmio::Cpu::disable_interrupts();
+            const ExceptionStats stats = this->m_exceptionStats[slot];
+            Va416x0Mmio::Cpu::enable_interrupts();
+            if (best == VT_TRACKED_EXCEPTIONS || stats.totalTicks > bestStats.totalTicks) {
+                best = slot;
+                bestStats = stats;
+            }
+        }
+        reported |= 1U << best;
+
+        this->log_ACTIVITY_LO_IrqStats(this->m_slotExceptions[best], bestStats.count, bestStats.totalTicks,
+                                       bestStats.maxTicks);
+
+        // The whole histogram doesn't fit in one event, so it's reported a segment at a time
+        for (U32 first = 0; first < VT_DURATION_BINS; first += VT_HISTOGRAM_SEGMENT_BINS) {
+            VtHistogramSegment segment;
+            bool empty = true;
+            for (U32 bin = 0; bin < VT_HISTOGRAM_SEGMENT_BINS; bin++) {
+                segment[bin] = bestStats.histogram[first + bin];
+                empty = empty && (segment[bin] == 0);
+            }
+            if (!empty) {
+                this->log_ACTIVITY_LO_IrqHistogram(this->m_slotExceptions[best], first, segment);
+            }
+        }
+    }
+    this->log_ACTIVITY_LO_IrqStatsSummary(tracked, this->m_untrackedCount.load());
+
+    this->cmdResponse_out(opCode, cmdSeq, Fw::CmdResponse::OK);
+}
+
+void VectorTable::handle_exception(U8 exception,
+                                   U32 clear_pending_address,
+                                   U32 clear_pending_bitmask,
+                                   const U32* frame) {
+    const U32* const outerFrame = this->m_exceptionFrame;
+    this->m_exceptionFrame = frame;
+
     // Special case: EXCEPTION_RESET is called at startup and never returns,
-    // so don't collect any metrics for it.
+    // and EXCEPTION_PEND_SV may run the main loop body (see MainLoop's
+    // sleep-on-exit idle mode). Both are thread-level work rather than
+    // interrupt load, so don't collect any metrics for them.
+    if (exception == Va416x0Types::ExceptionNumber::EXCEPTION_RESET ||
+        exception == Va416x0Types::ExceptionNumber::EXCEPTION_PEND_SV) {
+        [[clang::always_inline]] this->exceptions_out(exception);
+        this->m_exceptionFrame = outerFrame;
+        return;
+    }
 
     // Clear the interrupt immediately so that if the exception handler
-    // re-enables it, we can't accidentally clear it when we shouldn't.
+    // re-enables it, we can't accidentally clear it when we shouldn't. The
+    // register and bit are literals in each trampoline, so this is a single
+    // store.
+    if (clear_pending_address != 0) {
+        [[clang::always_inline]] Va416x0Mmio::Amba::write_u32(clear_pending_address, clear_pending_bitmask);
+    }
+
+    // Track nesting in software rather than with ICSR.RETTOBASE, which would
+    // report every interrupt that preempts a PendSV-hosted main loop as
+    // nested. Nested exceptions always return before the one they preempted,
+    // so a plain read-modify-write is safe here.
+    const U32 depth = this->m_nestingDepth;
+    FW_ASSERT(depth < MAX_NESTING_DEPTH, depth);
+    this->m_nestingDepth = depth + 1;
+
+    // Timestamps come from the DWT cycle counter, the same timebase used by
+    // MainLoop and the Profiler.
+    const U32 startTicks = Va416x0Mmio::Dwt::now_cycles();
+    // Read the nested totals inside the timed window, so that an exception
+    // preempting in between is charged to this one rather than subtracted
+    // without having been timed.
+    const U32 startNestedTicks = this->m_completedTicks[depth + 1];
+
+    [[clang::always_inline]] this->exceptions_out(exception);
+
+    const U32 endNestedTicks = this->m_completedTicks[depth + 1];
+    this->m_exceptionFrame = outerFrame;
+    const U32 endTicks = Va416x0Mmio::Dwt::now_cycles();
+
+    // CYCCNT counts up through the full 32 bits, so unsigned subtraction
+    // handles wraparound. A single exception would have to run for 2^32
+    // cycles (over 50 seconds at 80 MHz) to be measured incorrectly.
+    const U32 deltaTicks = endTicks - startTicks;
+
+    // Update the total for this depth before leaving it, so that nothing
+    // else at this depth can preempt the read-modify-write.
+    this->m_completedTicks[depth] += deltaTicks;
+    this->m_nestingDepth = depth;
+
+    this->record_duration(exception, deltaTicks - (endNestedTicks - startNestedTicks));
+
+    // If this is an outer interrupt, accumulate its duty utilization ticks.
+    // Nested interrupts are already included in the duration of the
+    // interrupt they preempted.
+    if (depth == 0) {
+        // Accumulate duty utilization ticks per-RTI.
+        m_rtiCurrentDutyUtilTicks += deltaTicks;
+    }
+}
+
+void VectorTable::handle_exception_untimed(U8 exception, const U32* frame) {
     if (exception >= Va416x0Types::BASE_NVIC_INTERRUPT) {
-        // FIXME: This is probably slower than it should be.
         [[clang::always_inline]] Va416x0Mmio::Nvic::set_interrupt_pending(
             Va416x0Types::ExceptionNumber(static_cast<const Va416x0Types::ExceptionNumber::T>(exception)), false);
     }
-    // Read start time from SysTick CVR (24-bit down-counter).
-    const U32 startTicks = Va416x0Mmio::SysTick::read_cvr();
 
+    const U32* const outerFrame = this->m_exceptionFrame;
+    this->m_exceptionFrame = frame;
     [[clang::always_inline]] this->exceptions_out(exception);
+    this->m_exceptionFrame = outerFrame;
+}
 
-    // Read end time.
-    const U32 endTicks = Va416x0Mmio::SysTick::read_cvr();
+void* VectorTable::select_handler(U32 exception) const {
+    if (!this->isConnected_exceptions_OutputPort(static_cast<FwIndexType>(exception))) {
+        return reinterpret_cast<void*>(arm_isr_unconnected);
+    }
+    if ((this->m_untimedExceptions[exception / 32] & (1U << (exception % 32))) != 0) {
+        return reinterpret_cast<void*>(arm_isr_untimed);
+    }
+    return arm_vector_table[exception];
+}
 
-    // Calculate elapsed ticks (SysTick counts DOWN, mask to 24-bit).
-    // Branchless: subtraction with 24-bit mask handles wraparound automatically.
-    // Note: this will not work correctly if the IRQ duration value cannot fit within 24 bits.
-    // For example, the maximum individual IRQ duration on the 80 MHz target (1 tick = 12.5 nsec)
-    // The maximum individual IRQ duration on the 40 MHz target (1 tick = 25 nsec)
-    // is expected not to exceed 209,715,187 nsec.
-    const U32 deltaTicks = (startTicks - endTicks) & 0x00FFFFFF;
+void VectorTable::install_vector_table() {
+    FW_ASSERT(!this->m_vectorTableInstalled);
+
+    // The initial stack pointer and reset entries are only used at reset, but
+    // keep them valid anyway.
+    ram_vector_table[0] = arm_vector_table[0];
+    ram_vector_table[Va416x0Types::ExceptionNumber::EXCEPTION_RESET] =
+        arm_vector_table[Va416x0Types::ExceptionNumber::EXCEPTION_RESET];
+    for (U32 exception = Va416x0Types::ExceptionNumber::EXCEPTION_NMI;
+         exception < Va416x0Types::NUMBER_OF_EXCEPTIONS; exception++) {
+        ram_vector_table[exception] = this->select_handler(exception);
+    }
 
-    // Determine if this is an outer interrupt using ARM's hardware RETTOBASE bit.
-    // RETTOBASE (bit 11 of ICSR) is 1 when there are no preempted active exceptions,
-    // meaning this is an outer (not nested) interrupt.
-    const bool isOuterInterrupt = (Va416x0Mmio::SysControl::read_icsr() & Va416x0Mmio::SysControl::ICSR_RETTOBASE) != 0;
+    // All accesses to the System Control Space must be followed by DSB + ISB.
+    // The DSB before it also makes sure that the table has been written.
+    Va416x0Mmio::Amba::memory_barrier();
+    Va416x0Mmio::SysControl::write_vtor(reinterpret_cast<U32>(ram_vector_table));
+    Va416x0Mmio::Amba::memory_barrier();
+    __isb(0xF);
 
-    // If this is an outer interrupt, count it and accumulate its duty utilization ticks.
-    if (isOuterInterrupt) {
-        // Accumulate duty utilization ticks per-RTI.
-        m_rtiCurrentDutyUtilTicks += deltaTicks;
+    this->m_vectorTableInstalled = true;
+}
+
+void VectorTable::set_stats_enabled(Va416x0Types::ExceptionNumber exception, bool enabled) {
+    const U32 number = exception.e;
+    FW_ASSERT(number < Va416x0Types::NUMBER_OF_EXCEPTIONS, number);
+    // Reset and PendSV are never timed, and always go through handle_exception
+    FW_ASSERT(number > Va416x0Types::ExceptionNumber::EXCEPTION_RESET &&
+                  number != Va416x0Types::ExceptionNumber::EXCEPTION_PEND_SV,
+              number);
+
+    if (enabled) {
+        this->m_untimedExceptions[number / 32] &= ~(1U << (number % 32));
+    } else {
+        this->m_untimedExceptions[number / 32] |= 1U << (number % 32);
+    }
+    // A vector is fetched with a single word read, so the entry can be
+    // replaced while interrupts are enabled.
+    if (this->m_vectorTableInstalled) {
+        ram_vector_table[number] = this->select_handler(number);
+    }
+}
+
+void VectorTable::record_duration(U8 exception, U32 ticks) {
+    U8 level = this->m_priorityLevels[exception];
+    if (level == NO_LEVEL) {
+        level = static_cast<U8>(VectorTable::priority_level(exception));
+        this->m_priorityLevels[exception] = level;
+    }
+    this->m_priorityTicks[level] += ticks;
+
+    U8 slot = this->m_exceptionSlots[exception];
+    if (slot == NO_SLOT) {
+        // Hand out slots with an atomic increment, since a nested exception
+        // can also be assigning one. An exception never preempts itself, so
+        // its own entry in m_exceptionSlots has a single writer.
+        const bool full = this->m_assignedSlots.load(std::memory_order_relaxed) >= VT_TRACKED_EXCEPTIONS;
+        const U32 assigned =
+            full ? VT_TRACKED_EXCEPTIONS : this->m_assignedSlots.fetch_add(1, std::memory_order_relaxed);
+        if (assigned >= VT_TRACKED_EXCEPTIONS) {
+            this->m_untrackedCount.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        slot = static_cast<U8>(assigned);
+        this->m_slotExceptions[slot] = exception;
+        this->m_exceptionSlots[exception] = slot;
+    }
+
+    ExceptionStats& stats = this->m_exceptionStats[slot];
+    stats.count++;
+    stats.totalTicks += ticks;
+    if (ticks > stats.maxTicks) {
+        stats.maxTicks = ticks;
+    }
+    U32 bin = (ticks == 0) ? 0 : 32 - static_cast<U32>(__builtin_clz(ticks));
+    if (bin >= VT_DURATION_BINS) {
+        bin = VT_DURATION_BINS - 1;
     }
+    stats.histogram[bin]++;
+}
+
+U32 VectorTable::priority_level(U8 exception) {
+    U32 priority;
+    if (exception >= Va416x0Types::BASE_NVIC_INTERRUPT) {
+        priority = Va416x0Mmio::Nvic::get_interrupt_priority(
+            Va416x0Types::ExceptionNumber(static_cast<const Va416x0Types::ExceptionNumber::T>(exception)));
+    } else if (exception >= Va416x0Types::ExceptionNumber::EXCEPTION_MEM_MANAGE) {
+        // SHPR1-3 hold one priority byte each for exceptions 4 through 15.
+        // See B3.2.10 in ARM DDI 0403E.e
+        const U32 index = exception - Va416x0Types::ExceptionNumber::EXCEPTION_MEM_MANAGE;
+        U32 shpr;
+        if (index < 4) {
+            shpr = Va416x0Mmio::SysControl::read_shpr1();
+        } else if (index < 8) {
+            shpr = Va416x0Mmio::SysControl::read_shpr2();
+        } else {
+            shpr = Va416x0Mmio::SysControl::read_shpr3();
+        }
+        priority = (shpr >> (8 * (index % 4))) & 0xFF;
+    } else {
+        return FIXED_PRIORITY_LEVEL;
+    }
+    return (priority & Va416x0Mmio::Nvic::PRIORITY_MASK) >> PRIORITY_LEVEL_SHIFT;
 }
 
 void VectorTable::endRti() {
@@ -126,18 +381,81 @@ void VectorTable::endRti() {
     if (this->m_rtiCurrentDutyUtilTicks > this->m_rtiHwmIrqDutyUtilTicks) {
         this->m_rtiHwmIrqDutyUtilTicks = this->m_rtiCurrentDutyUtilTicks;
     }
+    this->m_rtiLastDutyUtilTicks = this->m_rtiCurrentDutyUtilTicks;
     this->m_rtiCurrentDutyUtilTicks = 0;
     Va416x0Mmio::Cpu::enable_interrupts();
 }
 
+VtPriorityCycles VectorTable::getIrqCycles_handler(FwIndexType portNum) {
+    // Each total is a single aligned word, so each is read atomically. The
+    // totals may come from slightly different points in time, which only
+    // moves a few cycles from one reading to the next.
+    VtPriorityCycles cycles;
+    for (U32 level = 0; level < VT_PRIORITY_LEVELS; level++) {
+        cycles[level] = this->m_priorityTicks[level];
+    }
+    return cycles;
+}
+
+U32 VectorTable::getExceptionFrame_handler(FwIndexType portNum) {
+    return static_cast<U32>(reinterpret_cast<uintptr_t>(this->m_exceptionFrame));
+}
+
+U32 VectorTable::getLastRtiIrqDuty_handler(FwIndexType portNum) {
+    // A single aligned word read is atomic, so no lock is needed against endRti.
+    return this->m_rtiLastDutyUtilTicks;
+}
+
 void VectorTable::Run_handler(FwIndexType portNum, U32 context) {
     // Telemetry is updated atomically in interrupt context, but written to the telemetry buffer
     // from the safe, scheduled PassiveRateGroup context.
     this->tlmWrite_RtiIrqDutyCycleHwm(this->m_rtiHwmIrqDutyUtilTicks);
+
+    if (this->m_vectorTableInstalled) {
+        this->scrub_vector_table();
+    }
+}
+
+void VectorTable::scrub_vector_table() {
+    // Unlike the flash vector table, the RAM copy can be corrupted by an
+    // upset. Every entry can be recomputed from the port connections, so
+    // check a few of them on each call and repair any that don't match.
+    U32 exception = this->m_scrubCursor;
+    for (U32 i = 0; i < SCRUB_ENTRIES_PER_RUN; i++) {
+        if (exception >= Va416x0Types::NUMBER_OF_EXCEPTIONS) {
+            exception = Va416x0Types::ExceptionNumber::EXCEPTION_NMI;
+        }
+        void* const expected = this->select_handler(exception);
+        if (ram_vector_table[exception] != expected) {
+            ram_vector_table[exception] = expected;
+            this->log_WARNING_HI_VectorRepaired(exception);
+        }
+        exception++;
+    }
+    this->m_scrubCursor = exception;
 }
 
 }  // namespace Va416x0Svc
 
+extern "C" {
+void arm_isr_untimed_body(const U32* frame) {
+    [[clang::always_inline]] va416x0_vector_table_instance->handle_exception_untimed(
+        static_cast<U8>(Va416x0Mmio::Cpu::get_active_exception()), frame);
+}
+
+// Shared by every exception that has statistics disabled. IPSR identifies the
+// exception, so no per-exception trampoline is needed.
+__attribute__((naked)) void arm_isr_untimed(void) {
+    VA416X0_EXCEPTION_ENTRY("arm_isr_untimed_body");
+}
+
+// Shared by every exception whose port is not connected. This is the same
+// outcome as invoking an unconnected port, without the dispatch.
+void arm_isr_unconnected(void) {
+    FW_ASSERT(0, Va416x0Mmio::Cpu::get_active_exception());
+}
+}
+
 extern "C" char __data_source[];
 extern "C" char __data_start[];
 extern "C" char __data_size[];
@@ -153,6 +471,10 @@ extern "C" void _start(void) {
         Va416x0Mmio::Cpu::nop();
     }
 
+    // Start the cycle counter first, so that it's running for anything that
+    // timestamps during initialization.
+    Va416x0Mmio::Dwt::enable_cycle_counter();
+
     // Enable Floating-Point Coprocessor in CPACR register.
     Va416x0Mmio::SysControl::write_cpacr(Va416x0Mmio::SysControl::CPACR_ENABLE_FP_COPROCESSOR);
     // All accesses to the System Control Space must be followed by DSB + ISB.
@@ -187,9 +509,11 @@ extern "C" void _start(void) {
     // Instead of calling "main", we'll set up the deployment and then use a
     // port call.
     initialize_deployment();
+    // Now that the ports are connected, stop dispatching unused exceptions.
+    va416x0_vector_table_instance->install_vector_table();
     // This pointer will be optimized out at compile time.
     [[clang::always_inline]] va416x0_vector_table_instance->handle_exception(
-        Va416x0Types::ExceptionNumber::EXCEPTION_RESET);
+        Va416x0Types::ExceptionNumber::EXCEPTION_RESET, 0, 0, nullptr);
 
     // If the port call returns, halt.
     _exit(0);
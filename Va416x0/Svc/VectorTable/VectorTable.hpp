@@ -23,7 +23,15 @@
 #define Components_Va416x0_VectorTable_HPP
 
 #include <atomic>
+#include "Va416x0/Svc/VectorTable/FppConstantsAc.hpp"
 #include "Va416x0/Svc/VectorTable/VectorTableComponentAc.hpp"
+#include "Va416x0/Types/FppConstantsAc.hpp"
+
+//! Only statement of a naked exception entry point. Passes the exception frame stacked by the hardware to the
+//! extern "C" function `body`, taking it from the main or process stack as selected by EXC_RETURN, and branches to
+//! it with LR intact so that `body` returns straight from the exception.
+#define VA416X0_EXCEPTION_ENTRY(body) \
+    __asm__ volatile("tst lr, #4\n\tite eq\n\tmrseq r0, msp\n\tmrsne r0, psp\n\tb " body)
 
 namespace Va416x0Svc {
 
@@ -40,7 +48,28 @@ class VectorTable : public VectorTableComponentBase {
     //! Destroy VectorTable object
     ~VectorTable();
 
-    void handle_exception(U8 exception);
+    //! Time and dispatch an exception. For NVIC interrupts, the generated trampolines also pass the
+    //! address of the Interrupt Clear-Pending Register and the bit to write to it; other exceptions
+    //! pass 0 for both. frame is the exception frame stacked on entry, see VA416X0_EXCEPTION_ENTRY.
+    void handle_exception(U8 exception, U32 clear_pending_address, U32 clear_pending_bitmask, const U32* frame);
+
+    //! Dispatch an exception without collecting statistics for it
+    void handle_exception_untimed(U8 exception, const U32* frame);
+
+    //! Switch to a copy of the vector table in RAM, in which exceptions whose port is not connected
+    //! go straight to a shared handler. Must be called once the topology has been connected.
+    //! Connected exceptions still dispatch through the exceptions port array: the generated
+    //! trampolines are built per module and can't see which component a port is connected to.
+    //! The Run port checks a slice of the RAM table on each call and repairs upset entries.
+    void install_vector_table();
+
+    //! Enable or disable statistics collection for an exception, such as a high-rate interrupt
+    //! whose handler is too short to be worth timing. When it preempts a timed exception, its
+    //! time is counted as part of that exception. When it preempts thread code, its time isn't
+    //! counted anywhere: the RTI duty cycle and the per-priority totals undercount by that much,
+    //! and MainLoop reports it as main loop or idle time. Can be called before or after
+    //! install_vector_table.
+    void set_stats_enabled(Va416x0Types::ExceptionNumber exception, bool enabled);
 
     // ----------------------------------------------------------------------
     // Public accessor methods for timing data
@@ -65,6 +94,18 @@ class VectorTable : public VectorTableComponentBase {
                      U32 context           //!< The call order
     );
 
+    //! Handler implementation for getLastRtiIrqDuty
+    U32 getLastRtiIrqDuty_handler(FwIndexType portNum  //!< The port number
+    );
+
+    //! Handler implementation for getIrqCycles
+    VtPriorityCycles getIrqCycles_handler(FwIndexType portNum  //!< The port number
+    );
+
+    //! Handler implementation for getExceptionFrame
+    U32 getExceptionFrame_handler(FwIndexType portNum  //!< The port number
+    );
+
     // ----------------------------------------------------------------------
     // Handler implementations for commands
     // ----------------------------------------------------------------------
@@ -74,6 +115,36 @@ class VectorTable : public VectorTableComponentBase {
                                      U32 cmdSeq            //!< The command sequence number
     );
 
+    //! Handler for command REPORT_TOP_IRQS
+    void REPORT_TOP_IRQS_cmdHandler(FwOpcodeType opCode,  //!< The opcode
+                                    U32 cmdSeq,           //!< The command sequence number
+                                    U32 count             //!< Number of exceptions to report
+    );
+
+    //! Add one invocation of an exception to its duration statistics and to the time of its priority level
+    void record_duration(U8 exception, U32 ticks);
+
+    //! Index into m_priorityTicks for an exception, from its currently configured priority
+    static U32 priority_level(U8 exception);
+
+    //! Entry for an exception in the RAM vector table
+    void* select_handler(U32 exception) const;
+
+    //! Check the next few RAM vector table entries and repair any that were upset
+    void scrub_vector_table();
+
+    //! Duration statistics of one exception, in ticks
+    struct ExceptionStats {
+        U32 count;
+        U64 totalTicks;
+        U32 maxTicks;
+        U32 histogram[VT_DURATION_BINS];
+    };
+
+    //! Deepest exception nesting supported. The VA416x0 has 8 programmable priority levels, and NMI
+    //! and HardFault can preempt those.
+    static constexpr U32 MAX_NESTING_DEPTH = 16;
+
     // ----------------------------------------------------------------------
     // Member variables for exception timing
     // ----------------------------------------------------------------------
@@ -84,8 +155,49 @@ class VectorTable : public VectorTableComponentBase {
     // Last RTI IRQ duty cycle.
     U32 m_rtiCurrentDutyUtilTicks;  //!< Cumulative ticks of all outer interrupts in current RTI period
 
+    // IRQ duty cycle of the most recently completed RTI.
+    U32 m_rtiLastDutyUtilTicks;  //!< Cumulative ticks of all outer interrupts in the last complete RTI period
+
     // Per-RTI IRQ duty cycle High Water Mark.
     U32 m_rtiHwmIrqDutyUtilTicks;  //!< High water mark for cumulative ticks of all outer interrupts in any RTI period
+
+    // Number of timed exceptions currently active, excluding reset and PendSV.
+    U32 m_nestingDepth;
+
+    // Frame stacked on entry to the innermost exception being dispatched, or nullptr. Each
+    // exception restores the previous value before returning, so nesting needs no lock.
+    const U32* m_exceptionFrame;
+
+    // Per-depth running totals of ticks spent in completed exceptions, used to subtract the
+    // exceptions that preempted a handler from its duration. Entry N counts exceptions that ran
+    // at nesting depth N; wraparound cancels out when taking differences.
+    U32 m_completedTicks[MAX_NESTING_DEPTH + 1];
+
+    // Per-exception duration statistics, in slots assigned on first use.
+    U8 m_exceptionSlots[Va416x0Types::NUMBER_OF_EXCEPTIONS];  //!< Slot of each exception, or NO_SLOT
+    U8 m_slotExceptions[VT_TRACKED_EXCEPTIONS];               //!< Exception number of each assigned slot
+    ExceptionStats m_exceptionStats[VT_TRACKED_EXCEPTIONS];
+    std::atomic<U32> m_assignedSlots;   //!< Number of slots handed out, which may overshoot when full
+    std::atomic<U32> m_untrackedCount;  //!< Invocations of exceptions that did not get a slot
+
+    // Priority level of each exception, or NO_LEVEL until its first timed invocation. Caching it
+    // keeps the NVIC and SHPR reads off the exception path. An exception never preempts itself,
+    // so each entry has a single writer.
+    U8 m_priorityLevels[Va416x0Types::NUMBER_OF_EXCEPTIONS];
+
+    // Running totals of ticks spent in exceptions by priority level, excluding
+    // preemption. Exceptions at the same priority can't preempt each other, so
+    // each entry only has one writer at a time.
+    U32 m_priorityTicks[VT_PRIORITY_LEVELS];
+
+    // Bit N of word N / 32 is set if statistics are disabled for exception N.
+    U32 m_untimedExceptions[(Va416x0Types::NUMBER_OF_EXCEPTIONS + 31) / 32];
+
+    // True once the RAM vector table is in use.
+    bool m_vectorTableInstalled;
+
+    // Next RAM vector table entry to be checked by scrub_vector_table.
+    U32 m_scrubCursor;
 };
 
 }  // namespace Va416x0Svc
@@ -15,6 +15,18 @@
 # SPDX-License-Identifier: Apache-2.0
 
 NUMBER_OF_EXCEPTIONS = 212
+BASE_NVIC_INTERRUPT = 16
+# Interrupt Clear-Pending Registers, see B3.4.6 in ARM DDI 0403E.e
+NVIC_ICPR_ADDRESS = 0xE000E280
+
+
+def clear_pending_args(isr_index):
+    """Clear-pending register address and bitmask of an NVIC interrupt, or zeros for other exceptions"""
+    if isr_index < BASE_NVIC_INTERRUPT:
+        return "0, 0"
+    interrupt = isr_index - BASE_NVIC_INTERRUPT
+    return f"0x{NVIC_ICPR_ADDRESS + 4 * (interrupt >> 5):08X}, 0x{1 << (interrupt & 0x1F):08X}"
+
 
 print(
     f"""
@@ -23,6 +35,8 @@ print(
 
 static_assert(Va416x0Types::NUMBER_OF_EXCEPTIONS == {NUMBER_OF_EXCEPTIONS},
               "Autocoded number of exceptions did not match FPP number of exceptions.");
+static_assert(Va416x0Types::BASE_NVIC_INTERRUPT == {BASE_NVIC_INTERRUPT},
+              "Autocoded base NVIC interrupt did not match FPP base NVIC interrupt.");
 
 extern "C" {{
 extern void _start(void);
@@ -32,8 +46,12 @@ extern uint8_t __stack[];
 for isr_index in range(2, NUMBER_OF_EXCEPTIONS):
     print(
         f"""
-void arm_isr_{isr_index}(void) {{
-    [[clang::always_inline]] va416x0_vector_table_instance->handle_exception({isr_index});
+extern "C" void arm_isr_{isr_index}_body(const U32* frame) {{
+    [[clang::always_inline]] va416x0_vector_table_instance->handle_exception({isr_index}, {clear_pending_args(isr_index)}, frame);
+}}
+
+__attribute__((naked)) void arm_isr_{isr_index}(void) {{
+    VA416X0_EXCEPTION_ENTRY("arm_isr_{isr_index}_body");
 }}"""
     )
 print(
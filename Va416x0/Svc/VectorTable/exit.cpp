@@ -21,10 +21,18 @@
 extern "C" {
 volatile bool has_entered_exit = false;
 
+// Defined by the Profiler when it is linked in.
+__attribute__((weak)) void va416x0_profiler_freeze();
+
 [[noreturn]] void _exit(int status) {
     // Disable interrupt processing.
     __arm_wsr("faultmask", 1);
 
+    // Stop the profiler before anything else, so that a ring capture ends at the failure.
+    if (va416x0_profiler_freeze != nullptr) {
+        va416x0_profiler_freeze();
+    }
+
     // Attempt to log a message, but do not recurse.
     if (!has_entered_exit) {
         has_entered_exit = true;
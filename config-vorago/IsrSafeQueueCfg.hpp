@@ -0,0 +1,43 @@
+// Copyright 2026 California Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// ======================================================================
+// \title  IsrSafeQueueCfg.hpp
+// \brief  Configuration file for the IsrSafeQueue implementation
+// ======================================================================
+
+#ifndef ISR_SAFE_QUEUE_CFG_HPP
+#define ISR_SAFE_QUEUE_CFG_HPP
+
+#include <Fw/FPrimeBasicTypes.hpp>
+
+namespace Va416x0Os {
+namespace IsrSafeQueue {
+
+//! Size of the static pool that queue storage is carved from, in bytes. Each queue takes one block of
+//! IsrSafeQueue::getStorageSize(depth, messageSize) bytes, and blocks are never returned to the pool.
+//! 0 disables the pool, in which case each block is allocated from the SYSTEM memory allocator instead.
+//! NOTE: this should be overridden with the sum over the deployment's queues
+constexpr FwSizeType ISR_SAFE_QUEUE_POOL_SIZE = 0;
+
+//! Whether each queued message is timestamped so that queue latency can be reported, which costs 4 bytes of queue
+//! storage per message and a cycle counter read on every send and receive.
+constexpr bool ISR_SAFE_QUEUE_LATENCY_TRACKING = false;
+
+}  // namespace IsrSafeQueue
+}  // namespace Va416x0Os
+
+#endif
@@ -34,6 +34,12 @@ constexpr U32* PROFILER_MEMORY_REGION_START = nullptr;
 //! NOTE: this must be overridden when using the Profiler
 constexpr U32 PROFILER_MEMORY_REGION_SIZE = 0;
 
+//! Number of distinct functions that the COMPACT mode can record by index, which costs 4 bytes of RAM each.
+//! Functions beyond this are recorded with their full address. Must be 0 or a power of two no greater than 0x4000.
+//! With 0, the table is left out and every COMPACT function entry carries its full address; set it to 1024 or so
+//! in deployments that use COMPACT captures.
+constexpr U32 PROFILER_FUNCTION_TABLE_SIZE = 0;
+
 }  // namespace Va416x0Svc
 
 #endif